@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2019  Red Hat, Inc.
+ * Author(s):  David Cantrell <dcantrell@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Bump pointer allocator for data that lives and dies together, such
+ * as the file list of a package.  Memory comes from large blocks and
+ * is only released all at once with arena_free().  An arena is not
+ * thread safe, only one thread may allocate from it at a time.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rpminspect.h"
+
+#define ARENA_BLOCK_SIZE 65536
+#define ARENA_ALIGN      16
+
+struct arena_block {
+    struct arena_block *next;
+    size_t size;
+    size_t used;
+    unsigned char data[] __attribute__((aligned(ARENA_ALIGN)));
+};
+
+struct arena {
+    struct arena_block *blocks;
+};
+
+static struct arena_block *_new_block(size_t size) {
+    struct arena_block *block = NULL;
+
+    block = malloc(sizeof(*block) + size);
+    assert(block != NULL);
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+
+    return block;
+}
+
+struct arena *arena_new(void) {
+    struct arena *arena = NULL;
+
+    arena = calloc(1, sizeof(*arena));
+    assert(arena != NULL);
+    return arena;
+}
+
+/*
+ * Return size bytes of zeroed memory from the arena.  Requests too
+ * large to share a block get a block of their own, which is put behind
+ * the current block so its free space is not wasted.
+ */
+void *arena_alloc(struct arena *arena, size_t size) {
+    struct arena_block *block = NULL;
+    void *p = NULL;
+
+    assert(arena != NULL);
+
+    size = (size + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1);
+
+    if (size > ARENA_BLOCK_SIZE / 4) {
+        block = _new_block(size);
+
+        if (arena->blocks == NULL) {
+            arena->blocks = block;
+        } else {
+            block->next = arena->blocks->next;
+            arena->blocks->next = block;
+        }
+    } else {
+        block = arena->blocks;
+
+        if (block == NULL || block->size - block->used < size) {
+            block = _new_block(ARENA_BLOCK_SIZE);
+            block->next = arena->blocks;
+            arena->blocks = block;
+        }
+    }
+
+    p = (char *) block->data + block->used;
+    block->used += size;
+    memset(p, 0, size);
+
+    return p;
+}
+
+char *arena_strdup(struct arena *arena, const char *s) {
+    size_t len;
+    char *p = NULL;
+
+    assert(s != NULL);
+
+    len = strlen(s) + 1;
+    p = arena_alloc(arena, len);
+    memcpy(p, s, len);
+
+    return p;
+}
+
+/* Like asprintf(), but the string comes from the arena */
+char *arena_sprintf(struct arena *arena, const char *fmt, ...) {
+    va_list ap;
+    int len;
+    char *p = NULL;
+
+    va_start(ap, fmt);
+    len = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    assert(len >= 0);
+
+    p = arena_alloc(arena, len + 1);
+
+    va_start(ap, fmt);
+    vsnprintf(p, len + 1, fmt, ap);
+    va_end(ap);
+
+    return p;
+}
+
+/* Release everything allocated from the arena and the arena itself */
+void arena_free(struct arena *arena) {
+    struct arena_block *block = NULL;
+
+    if (arena == NULL) {
+        return;
+    }
+
+    while (arena->blocks != NULL) {
+        block = arena->blocks;
+        arena->blocks = block->next;
+        free(block);
+    }
+
+    free(arena);
+    return;
+}
@@ -21,49 +21,120 @@
 #include <sys/queue.h>
 #include <sys/types.h>
 #include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "rpminspect.h"
 
 /*
- * Check the given string for any defined bad words, return true if found.
+ * Compile the bad word expressions in badwords into one POSIX extended,
+ * case insensitive alternation so a string can be checked with a single
+ * regexec() call.  *out is set to NULL if there are no expressions.
+ * Returns 0 on success, -1 if the expressions do not compile.
  */
-bool has_bad_word(const char *s, const string_list_t *badwords) {
+int compile_bad_words(const string_list_t *badwords, regex_t **out) {
     string_entry_t *badexp = NULL;
-    regex_t re;
+    char *pattern = NULL;
+    char *tmp = NULL;
     int reg_result;
     char reg_error[BUFSIZ];
-    regmatch_t match[1];
-    bool found = false;
 
-    assert(s != NULL);
+    assert(out != NULL);
+    *out = NULL;
 
-    if (badwords == NULL) {
-        return false;
+    if (badwords == NULL || TAILQ_EMPTY(badwords)) {
+        return 0;
     }
 
-    /* check each bad word expression for a match with our string */
+    /* (exp1)|(exp2)|... so one expression cannot swallow the next */
     TAILQ_FOREACH(badexp, badwords, items) {
-        /* compile this expression, POSIX extended and case insensitive */
-        reg_result = regcomp(&re, badexp->data, REG_EXTENDED | REG_ICASE);
-
-        if (reg_result != 0) {
-            regerror(reg_result, &re, reg_error, sizeof(reg_error));
-            fprintf(stderr, "*** Unable to compile bad word regular expression: %s\n", reg_error);
-            fflush(stderr);
-            return false;
+        if (pattern == NULL) {
+            xasprintf(&tmp, "(%s)", badexp->data);
+        } else {
+            xasprintf(&tmp, "%s|(%s)", pattern, badexp->data);
         }
 
-        /* look for a match */
-        if (regexec(&re, s, 1, match, 0) == 0) {
-            found = true;
-        }
+        free(pattern);
+        pattern = tmp;
+    }
+
+    *out = calloc(1, sizeof(regex_t));
+    assert(*out != NULL);
+
+    if ((reg_result = regcomp(*out, pattern, REG_EXTENDED | REG_ICASE | REG_NOSUB)) != 0) {
+        regerror(reg_result, *out, reg_error, sizeof(reg_error));
+        fprintf(stderr, "*** Unable to compile bad word regular expression: %s\n", reg_error);
+        fflush(stderr);
+        free(*out);
+        *out = NULL;
+        free(pattern);
+        return -1;
+    }
+
+    free(pattern);
+    return 0;
+}
+
+/*
+ * Build a scanner for the space or tab separated bad words in words,
+ * the tests:badwords setting.  Like the expressions made from them, a
+ * word matches if it starts or ends at a word boundary.  Returns NULL
+ * if there are no words or if any word uses regular expression syntax,
+ * in which case the compiled expression has to be used instead.
+ */
+scanner_t *scan_bad_words(const char *words) {
+    scanner_t *scanner = NULL;
+    char *walk = NULL;
+    char *start = NULL;
+    char *badword = NULL;
+    size_t nwords = 0;
+
+    assert(words != NULL);
+
+    if (words[strcspn(words, ".[]()*+?{}|^$\\")] != '\0') {
+        return NULL;
+    }
 
-        /* clean up */
-        regfree(&re);
+    start = walk = strdup(words);
+    assert(start != NULL);
+    scanner = scanner_new();
 
-        if (found) {
-            break;
+    while ((badword = strsep(&walk, " \t")) != NULL) {
+        if (*badword == '\0') {
+            continue;
         }
+
+        scanner_add(scanner, badword, SCAN_WORD_START);
+        scanner_add(scanner, badword, SCAN_WORD_END);
+        nwords++;
+    }
+
+    free(start);
+
+    if (nwords == 0) {
+        scanner_free(scanner);
+        return NULL;
+    }
+
+    scanner_compile(scanner);
+    return scanner;
+}
+
+/*
+ * Check the given string for any of the bad words configured in ri,
+ * return true if found.
+ */
+bool has_bad_word(const char *s, const struct rpminspect *ri) {
+    assert(s != NULL);
+    assert(ri != NULL);
+
+    if (ri->badwords_scanner != NULL) {
+        return scanner_contains(ri->badwords_scanner, s);
+    }
+
+    if (ri->badwords_regex == NULL) {
+        return false;
     }
 
-    return found;
+    return regexec(ri->badwords_regex, s, 0, NULL, 0) == 0;
 }
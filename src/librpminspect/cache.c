@@ -0,0 +1,678 @@
+/*
+ * Copyright (C) 2019  Red Hat, Inc.
+ * Author(s):  David Cantrell <dcantrell@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Cache of packages downloaded from Koji.  Packages are stored by
+ * NVRA and the payload hash Koji reports for them, so a name can never
+ * refer to different contents.  The modification time of a cached
+ * package is bumped every time it is used and the least recently used
+ * packages are removed once the cache grows past ri->cachesize.
+ *
+ * The answers to the Koji hub queries for completed builds are kept
+ * in the koji subdirectory of the cache as well, since a completed
+ * build never changes.  They count toward ri->cachesize and age out
+ * the same way packages do.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <rpm/header.h>
+#include <rpm/rpmpgp.h>
+#include <json.h>
+#include "rpminspect.h"
+
+/*
+ * Version of the format of cached Koji responses.  Bump this when the
+ * format changes, files with a different version are ignored.
+ */
+#define KOJI_CACHE_SCHEMA 1
+
+/* Koji build states (see koji.BUILD_STATES) */
+#define KOJI_BUILD_COMPLETE 1
+
+/* Fields of struct koji_build saved in the Koji cache */
+static const struct {
+    const char *key;
+    size_t offset;
+} koji_build_strings[] = {
+    { "package_name", offsetof(struct koji_build, package_name) },
+    { "epoch", offsetof(struct koji_build, epoch) },
+    { "name", offsetof(struct koji_build, name) },
+    { "version", offsetof(struct koji_build, version) },
+    { "release", offsetof(struct koji_build, release) },
+    { "nvr", offsetof(struct koji_build, nvr) },
+    { "source", offsetof(struct koji_build, source) },
+    { "creation_time", offsetof(struct koji_build, creation_time) },
+    { "completion_time", offsetof(struct koji_build, completion_time) },
+    { "owner_name", offsetof(struct koji_build, owner_name) },
+    { "start_time", offsetof(struct koji_build, start_time) },
+    { "volume_name", offsetof(struct koji_build, volume_name) },
+    { NULL, 0 }
+}, koji_build_ints[] = {
+    { "package_id", offsetof(struct koji_build, package_id) },
+    { "id", offsetof(struct koji_build, id) },
+    { "build_id", offsetof(struct koji_build, build_id) },
+    { "state", offsetof(struct koji_build, state) },
+    { "owner_id", offsetof(struct koji_build, owner_id) },
+    { "creation_event_id", offsetof(struct koji_build, creation_event_id) },
+    { "volume_id", offsetof(struct koji_build, volume_id) },
+    { "task_id", offsetof(struct koji_build, task_id) },
+    { NULL, 0 }
+}, koji_build_doubles[] = {
+    { "completion_ts", offsetof(struct koji_build, completion_ts) },
+    { "start_ts", offsetof(struct koji_build, start_ts) },
+    { "creation_ts", offsetof(struct koji_build, creation_ts) },
+    { NULL, 0 }
+}, koji_rpm_strings[] = {
+    { "arch", offsetof(koji_rpmlist_entry_t, arch) },
+    { "name", offsetof(koji_rpmlist_entry_t, name) },
+    { "version", offsetof(koji_rpmlist_entry_t, version) },
+    { "release", offsetof(koji_rpmlist_entry_t, release) },
+    { "payloadhash", offsetof(koji_rpmlist_entry_t, payloadhash) },
+    { NULL, 0 }
+};
+
+#define FIELD(base, offset, type) ((type *) (((char *) (base)) + (offset)))
+
+/* Package file layout, see the RPM file format documentation */
+#define RPM_LEAD_SIZE        96
+#define RPM_HEADER_MAGIC     "\x8e\xad\xe8\x01"
+#define RPM_HEADER_INTRO     16
+#define RPM_INDEX_ENTRY_SIZE 16
+
+/* A file in the cache, used when making room */
+struct cache_entry {
+    char *path;
+    off_t size;
+    time_t used;
+};
+
+/* Return the cache directory to use, the caller must free it */
+static char *_get_cache_dir(const struct rpminspect *ri)
+{
+    char *dir = NULL;
+
+    if (ri->cachedir != NULL) {
+        dir = strdup(ri->cachedir);
+        assert(dir != NULL);
+    } else {
+        xasprintf(&dir, "%s/%s", ri->workdir, DEFAULT_CACHE_SUBDIR);
+    }
+
+    return dir;
+}
+
+/*
+ * Return the path of the cache entry for a package, or NULL if the
+ * package cannot be cached.  Packages without a payload hash from Koji
+ * are never cached because nothing ties the name to the contents.
+ */
+static char *_get_cache_path(const struct rpminspect *ri, const koji_rpmlist_entry_t *rpm)
+{
+    char *dir = NULL;
+    char *path = NULL;
+    const char *c = NULL;
+
+    if (ri->cachesize == 0 || rpm->payloadhash == NULL || *rpm->payloadhash == '\0') {
+        return NULL;
+    }
+
+    /* the hash goes in a file name, so only take what it should contain */
+    for (c = rpm->payloadhash; *c != '\0'; c++) {
+        if (!isxdigit((unsigned char) *c)) {
+            return NULL;
+        }
+    }
+
+    dir = _get_cache_dir(ri);
+    xasprintf(&path, "%s/%s-%s-%s.%s-%s.rpm", dir, rpm->name, rpm->version, rpm->release, rpm->arch, rpm->payloadhash);
+    free(dir);
+
+    return path;
+}
+
+static int _cmp_cache_entries(const void *a, const void *b)
+{
+    const struct cache_entry *x = a;
+    const struct cache_entry *y = b;
+
+    if (x->used < y->used) {
+        return -1;
+    } else if (x->used > y->used) {
+        return 1;
+    }
+
+    return strcmp(x->path, y->path);
+}
+
+/*
+ * Add the regular files in dir whose names end in suffix to entries,
+ * and their sizes to *total.  A missing directory adds nothing.
+ */
+static void _scan_cache_dir(const char *dir, const char *suffix, struct cache_entry **entries, size_t *nentries, uint64_t *total)
+{
+    DIR *d = NULL;
+    struct dirent *de = NULL;
+    struct stat sb;
+    char *path = NULL;
+
+    if ((d = opendir(dir)) == NULL) {
+        return;
+    }
+
+    while ((de = readdir(d)) != NULL) {
+        if (!strsuffix(de->d_name, suffix)) {
+            continue;
+        }
+
+        xasprintf(&path, "%s/%s", dir, de->d_name);
+
+        if (stat(path, &sb) != 0 || !S_ISREG(sb.st_mode)) {
+            free(path);
+            continue;
+        }
+
+        *entries = realloc(*entries, (*nentries + 1) * sizeof(**entries));
+        assert(*entries != NULL);
+        (*entries)[*nentries].path = path;
+        (*entries)[*nentries].size = sb.st_size;
+        (*entries)[*nentries].used = sb.st_mtime;
+        (*nentries)++;
+        *total += sb.st_size;
+    }
+
+    closedir(d);
+    return;
+}
+
+/*
+ * Remove the least recently used packages and Koji responses until the
+ * cache fits in its limit.  This scans the whole cache, so call it once
+ * after a batch of add_cached_rpm() calls, and not while other threads
+ * may be adding.
+ */
+void trim_cache(const struct rpminspect *ri)
+{
+    char *dir = NULL;
+    char *kojidir = NULL;
+    struct cache_entry *entries = NULL;
+    size_t nentries = 0;
+    size_t i;
+    uint64_t total = 0;
+
+    assert(ri != NULL);
+
+    if (ri->cachesize == 0) {
+        return;
+    }
+
+    dir = _get_cache_dir(ri);
+    xasprintf(&kojidir, "%s/koji", dir);
+    _scan_cache_dir(dir, ".rpm", &entries, &nentries, &total);
+    _scan_cache_dir(kojidir, ".json", &entries, &nentries, &total);
+
+    if (total > ri->cachesize) {
+        qsort(entries, nentries, sizeof(*entries), _cmp_cache_entries);
+
+        for (i = 0; i < nentries && total > ri->cachesize; i++) {
+            /* another rpminspect may have removed it already */
+            if (unlink(entries[i].path) == 0 || errno == ENOENT) {
+                total -= entries[i].size;
+            }
+        }
+    }
+
+    for (i = 0; i < nentries; i++) {
+        free(entries[i].path);
+    }
+
+    free(entries);
+    free(kojidir);
+    free(dir);
+    return;
+}
+
+static uint32_t _be32(const unsigned char *p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+/*
+ * Check that the MD5 of the header and payload of pkg, which is what
+ * RPMTAG_SIGMD5 and the Koji payload hash record, is md5.  The package
+ * is read with digest checks off, so this is the only thing that
+ * notices a download that was cut short or damaged after the header.
+ */
+static bool _verify_package_md5(const char *pkg, const char *md5)
+{
+    int fd;
+    unsigned char buf[BUFSIZ];
+    unsigned char *intro = buf + RPM_LEAD_SIZE;
+    off_t start;
+    ssize_t n;
+    DIGEST_CTX ctx = NULL;
+    char *digest = NULL;
+    bool result = false;
+
+    if ((fd = open(pkg, O_RDONLY)) == -1) {
+        return false;
+    }
+
+    /* skip the lead and the signature header, which is padded to 8 bytes */
+    if (read(fd, buf, RPM_LEAD_SIZE + RPM_HEADER_INTRO) != RPM_LEAD_SIZE + RPM_HEADER_INTRO
+        || memcmp(intro, RPM_HEADER_MAGIC, 4)) {
+        close(fd);
+        return false;
+    }
+
+    start = RPM_LEAD_SIZE + RPM_HEADER_INTRO
+            + (off_t) _be32(intro + 8) * RPM_INDEX_ENTRY_SIZE + _be32(intro + 12);
+    start = (start + 7) & ~((off_t) 7);
+
+    if (lseek(fd, start, SEEK_SET) != start) {
+        close(fd);
+        return false;
+    }
+
+    ctx = rpmDigestInit(PGPHASHALGO_MD5, RPMDIGEST_NONE);
+
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        rpmDigestUpdate(ctx, buf, n);
+    }
+
+    close(fd);
+    rpmDigestFinal(ctx, (void **) &digest, NULL, 1);
+
+    if (n == 0 && digest != NULL && !strcasecmp(digest, md5)) {
+        result = true;
+    }
+
+    free(digest);
+    return result;
+}
+
+/*
+ * Return the path of the cached copy of a Koji package, or NULL if it
+ * is not in the cache.  The caller must free the returned string.
+ */
+char *get_cached_rpm(const struct rpminspect *ri, const koji_rpmlist_entry_t *rpm)
+{
+    char *path = NULL;
+    struct stat sb;
+
+    assert(ri != NULL);
+    assert(rpm != NULL);
+
+    if ((path = _get_cache_path(ri, rpm)) == NULL) {
+        return NULL;
+    }
+
+    if (stat(path, &sb) != 0 || !S_ISREG(sb.st_mode) || sb.st_size == 0) {
+        free(path);
+        return NULL;
+    }
+
+    /* mark it as recently used */
+    utimensat(AT_FDCWD, path, NULL, 0);
+
+    return path;
+}
+
+/*
+ * Add the downloaded package pkg, whose header is hdr, to the cache as
+ * the Koji package rpm.  The package is only added if its SIGMD5
+ * matches the payload hash Koji reported and the header and payload
+ * actually have that MD5.  Failing to add a package is not an error, it
+ * just will not be cached.  Call trim_cache() once all packages have
+ * been added.
+ */
+void add_cached_rpm(const struct rpminspect *ri, const koji_rpmlist_entry_t *rpm, const char *pkg, Header hdr)
+{
+    char *dir = NULL;
+    char *path = NULL;
+    char *tmp = NULL;
+    char *sigmd5 = NULL;
+
+    assert(ri != NULL);
+    assert(rpm != NULL);
+    assert(pkg != NULL);
+    assert(hdr != NULL);
+
+    if ((path = _get_cache_path(ri, rpm)) == NULL) {
+        return;
+    }
+
+    /* make sure we got what Koji said we would */
+    sigmd5 = headerGetAsString(hdr, RPMTAG_SIGMD5);
+
+    if (sigmd5 == NULL || strcasecmp(sigmd5, rpm->payloadhash)) {
+        fprintf(stderr, "*** Payload hash of %s does not match Koji, not caching it\n", pkg);
+        fflush(stderr);
+        goto cleanup;
+    }
+
+    if (!_verify_package_md5(pkg, rpm->payloadhash)) {
+        fprintf(stderr, "*** %s is damaged or incomplete, not caching it\n", pkg);
+        fflush(stderr);
+        goto cleanup;
+    }
+
+    dir = _get_cache_dir(ri);
+
+    if (mkdirp(dir, S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH) == -1) {
+        goto cleanup;
+    }
+
+    /* put it in place in one step so no one sees a partial package */
+    xasprintf(&tmp, "%s.%ld.tmp", path, (long) getpid());
+    unlink(tmp);
+
+    if (link(pkg, tmp) == -1 && copyfile(pkg, tmp, true, false) != 0) {
+        goto cleanup;
+    }
+
+    if (rename(tmp, path) == -1) {
+        fprintf(stderr, "*** Unable to add %s to the cache: %s\n", pkg, strerror(errno));
+        fflush(stderr);
+        unlink(tmp);
+        goto cleanup;
+    }
+
+cleanup:
+    free(sigmd5);
+    free(dir);
+    free(path);
+    free(tmp);
+    return;
+}
+
+/*
+ * Return the path of the cached Koji response for buildspec on the hub
+ * in ri->kojihub.  The name is a hash of the two, the file itself holds
+ * both so a hash collision is noticed.
+ */
+static char *_get_koji_cache_path(const struct rpminspect *ri, const char *buildspec)
+{
+    char *dir = NULL;
+    char *path = NULL;
+    uint64_t hash = 14695981039346656037ULL;
+    const char *c = NULL;
+
+    if (ri->cachesize == 0 || ri->kojihub == NULL) {
+        return NULL;
+    }
+
+    /* FNV-1a of "hub\nbuildspec" */
+    for (c = ri->kojihub; *c != '\0'; c++) {
+        hash = (hash ^ (unsigned char) *c) * 1099511628211ULL;
+    }
+
+    hash = (hash ^ '\n') * 1099511628211ULL;
+
+    for (c = buildspec; *c != '\0'; c++) {
+        hash = (hash ^ (unsigned char) *c) * 1099511628211ULL;
+    }
+
+    dir = _get_cache_dir(ri);
+    xasprintf(&path, "%s/koji/%016llx.json", dir, (unsigned long long) hash);
+    free(dir);
+
+    return path;
+}
+
+/* Read a whole file into a NUL terminated string, the caller must free it */
+static char *_read_file(const char *path)
+{
+    FILE *fp = NULL;
+    char *data = NULL;
+    long size;
+
+    if ((fp = fopen(path, "r")) == NULL) {
+        return NULL;
+    }
+
+    if (fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp)) > 0 && fseek(fp, 0, SEEK_SET) == 0) {
+        data = calloc(1, size + 1);
+        assert(data != NULL);
+
+        if (fread(data, 1, size, fp) != (size_t) size) {
+            free(data);
+            data = NULL;
+        }
+    }
+
+    fclose(fp);
+    return data;
+}
+
+/* Return the string value of key in obj, or NULL */
+static const char *_get_json_string(struct json_object *obj, const char *key)
+{
+    struct json_object *value = NULL;
+
+    if (!json_object_object_get_ex(obj, key, &value) || json_object_get_type(value) != json_type_string) {
+        return NULL;
+    }
+
+    return json_object_get_string(value);
+}
+
+/*
+ * Return the build for buildspec from the Koji response cache, or NULL
+ * if it is not there.  The caller must free the build with
+ * free_koji_build().
+ */
+struct koji_build *get_cached_koji_build(const struct rpminspect *ri, const char *buildspec)
+{
+    char *path = NULL;
+    char *data = NULL;
+    const char *s = NULL;
+    struct json_object *top = NULL;
+    struct json_object *obj = NULL;
+    struct json_object *rpms = NULL;
+    struct json_object *element = NULL;
+    struct koji_build *build = NULL;
+    koji_rpmlist_entry_t *rpm = NULL;
+    size_t i;
+    size_t j;
+
+    assert(ri != NULL);
+    assert(buildspec != NULL);
+
+    if ((path = _get_koji_cache_path(ri, buildspec)) == NULL) {
+        return NULL;
+    }
+
+    if ((data = _read_file(path)) == NULL || (top = json_tokener_parse(data)) == NULL) {
+        goto cleanup;
+    }
+
+    /* only take responses in the current format for this exact query */
+    if (!json_object_object_get_ex(top, "schema", &obj) || json_object_get_int(obj) != KOJI_CACHE_SCHEMA) {
+        goto cleanup;
+    }
+
+    if ((s = _get_json_string(top, "hub")) == NULL || strcmp(s, ri->kojihub)) {
+        goto cleanup;
+    }
+
+    if ((s = _get_json_string(top, "buildspec")) == NULL || strcmp(s, buildspec)) {
+        goto cleanup;
+    }
+
+    if (!json_object_object_get_ex(top, "rpms", &rpms) || json_object_get_type(rpms) != json_type_array) {
+        goto cleanup;
+    }
+
+    build = calloc(1, sizeof(*build));
+    assert(build != NULL);
+    init_koji_build(build);
+
+    for (i = 0; koji_build_strings[i].key != NULL; i++) {
+        if ((s = _get_json_string(top, koji_build_strings[i].key)) != NULL) {
+            *FIELD(build, koji_build_strings[i].offset, char *) = strdup(s);
+        }
+    }
+
+    for (i = 0; koji_build_ints[i].key != NULL; i++) {
+        if (json_object_object_get_ex(top, koji_build_ints[i].key, &obj)) {
+            *FIELD(build, koji_build_ints[i].offset, int) = json_object_get_int(obj);
+        }
+    }
+
+    for (i = 0; koji_build_doubles[i].key != NULL; i++) {
+        if (json_object_object_get_ex(top, koji_build_doubles[i].key, &obj)) {
+            *FIELD(build, koji_build_doubles[i].offset, double) = json_object_get_double(obj);
+        }
+    }
+
+    for (i = 0; i < json_object_array_length(rpms); i++) {
+        element = json_object_array_get_idx(rpms, i);
+        rpm = calloc(1, sizeof(*rpm));
+        assert(rpm != NULL);
+
+        for (j = 0; koji_rpm_strings[j].key != NULL; j++) {
+            if ((s = _get_json_string(element, koji_rpm_strings[j].key)) != NULL) {
+                *FIELD(rpm, koji_rpm_strings[j].offset, char *) = strdup(s);
+            }
+        }
+
+        TAILQ_INSERT_TAIL(build->rpms, rpm, items);
+    }
+
+    /* mark the response as recently used so trim_cache() keeps it */
+    utimensat(AT_FDCWD, path, NULL, 0);
+
+cleanup:
+    if (top != NULL) {
+        json_object_put(top);
+    }
+
+    free(data);
+    free(path);
+    return build;
+}
+
+/*
+ * Save the answer from the Koji hub for buildspec in the response
+ * cache.  Only completed builds are saved, anything else may still
+ * change.
+ */
+void add_cached_koji_build(const struct rpminspect *ri, const char *buildspec, const struct koji_build *build)
+{
+    char *path = NULL;
+    char *tmp = NULL;
+    char *dir = NULL;
+    const char *s = NULL;
+    struct json_object *top = NULL;
+    struct json_object *rpms = NULL;
+    struct json_object *element = NULL;
+    koji_rpmlist_entry_t *rpm = NULL;
+    FILE *fp = NULL;
+    size_t i;
+    bool ok;
+
+    assert(ri != NULL);
+    assert(buildspec != NULL);
+    assert(build != NULL);
+
+    if (build->state != KOJI_BUILD_COMPLETE) {
+        return;
+    }
+
+    if ((path = _get_koji_cache_path(ri, buildspec)) == NULL) {
+        return;
+    }
+
+    top = json_object_new_object();
+    json_object_object_add(top, "schema", json_object_new_int(KOJI_CACHE_SCHEMA));
+    json_object_object_add(top, "hub", json_object_new_string(ri->kojihub));
+    json_object_object_add(top, "buildspec", json_object_new_string(buildspec));
+
+    for (i = 0; koji_build_strings[i].key != NULL; i++) {
+        if ((s = *FIELD(build, koji_build_strings[i].offset, char *)) != NULL) {
+            json_object_object_add(top, koji_build_strings[i].key, json_object_new_string(s));
+        }
+    }
+
+    for (i = 0; koji_build_ints[i].key != NULL; i++) {
+        json_object_object_add(top, koji_build_ints[i].key, json_object_new_int(*FIELD(build, koji_build_ints[i].offset, int)));
+    }
+
+    for (i = 0; koji_build_doubles[i].key != NULL; i++) {
+        json_object_object_add(top, koji_build_doubles[i].key, json_object_new_double(*FIELD(build, koji_build_doubles[i].offset, double)));
+    }
+
+    rpms = json_object_new_array();
+
+    TAILQ_FOREACH(rpm, build->rpms, items) {
+        element = json_object_new_object();
+
+        for (i = 0; koji_rpm_strings[i].key != NULL; i++) {
+            if ((s = *FIELD(rpm, koji_rpm_strings[i].offset, char *)) != NULL) {
+                json_object_object_add(element, koji_rpm_strings[i].key, json_object_new_string(s));
+            }
+        }
+
+        json_object_array_add(rpms, element);
+    }
+
+    json_object_object_add(top, "rpms", rpms);
+
+    /* write it next to its final name, then move it in place */
+    dir = strdup(path);
+    assert(dir != NULL);
+
+    if (mkdirp(dirname(dir), S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH) == -1) {
+        goto cleanup;
+    }
+
+    xasprintf(&tmp, "%s.%ld.tmp", path, (long) getpid());
+
+    if ((fp = fopen(tmp, "w")) == NULL) {
+        goto cleanup;
+    }
+
+    ok = (fputs(json_object_to_json_string_ext(top, JSON_C_TO_STRING_PLAIN), fp) != EOF);
+
+    if (fclose(fp) != 0 || !ok || rename(tmp, path) == -1) {
+        unlink(tmp);
+    }
+
+cleanup:
+    json_object_put(top);
+    free(dir);
+    free(tmp);
+    free(path);
+    return;
+}
@@ -39,6 +39,23 @@
  */
 #define DEFAULT_WORKDIR "/var/tmp/rpminspect"
 
+/*
+ * How many packages to download from Koji at the same time and how
+ * many times to retry a failed download.  Each retry waits twice as
+ * long as the one before it, starting at DOWNLOAD_RETRY_DELAY seconds.
+ */
+#define DEFAULT_DOWNLOAD_JOBS 4
+#define DEFAULT_DOWNLOAD_RETRIES 3
+#define DOWNLOAD_RETRY_DELAY 1
+
+/*
+ * Downloaded packages are kept in this subdirectory of the working
+ * directory, up to DEFAULT_CACHE_SIZE megabytes, unless the
+ * configuration file says otherwise.
+ */
+#define DEFAULT_CACHE_SUBDIR "cache"
+#define DEFAULT_CACHE_SIZE 10240
+
 /*
  * Standard location for the license database.  Can be changed
  * in the configuration file.
@@ -25,9 +25,11 @@
 #include <libgen.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <linux/fs.h>
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
@@ -173,3 +175,111 @@ int copyfile(const char *src, const char *dest, bool force, bool verbose) {
 
     return success;
 }
+
+/* Give a cloned file the ownership and permissions of the original */
+static int _copy_attrs(int fd, const char *dest, const struct stat *sb) {
+    if (geteuid() == 0 && fchown(fd, sb->st_uid, sb->st_gid) == -1) {
+        fprintf(stderr, "*** chown() error on %s: %s\n", dest, strerror(errno));
+        fflush(stderr);
+        return -1;
+    }
+
+    if (fchmod(fd, (sb->st_mode & (S_ISUID | S_ISGID | S_ISVTX | S_IRWXU | S_IRWXG | S_IRWXO))) == -1) {
+        fprintf(stderr, "*** chmod() error on %s: %s\n", dest, strerror(errno));
+        fflush(stderr);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Put a copy of the regular file src at dest as cheaply as the
+ * filesystem allows: a reflink (FICLONE) that shares the data blocks,
+ * then a hard link, then an in-kernel copy_file_range() copy.  Only if
+ * none of those work is the data read and written with copyfile().
+ * An existing dest is replaced.  Callers must treat dest as read-only
+ * since it may share its data or its inode with src.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+int ingestfile(const char *src, const char *dest) {
+    struct stat sb;
+    int in = -1;
+    int out = -1;
+    int ret = -1;
+    mode_t mode = (S_IRWXU | S_IRGRP | S_IROTH) ^ S_IXUSR;
+#ifdef HAVE_COPY_FILE_RANGE
+    off_t remaining;
+    ssize_t r;
+#endif
+
+    assert(src != NULL);
+    assert(dest != NULL);
+
+    if (stat(src, &sb) == -1 || !S_ISREG(sb.st_mode)) {
+        return copyfile(src, dest, true, false);
+    }
+
+    if ((in = open(src, O_RDONLY)) == -1) {
+        return copyfile(src, dest, true, false);
+    }
+
+    unlink(dest);
+
+#ifdef FICLONE
+    /* reflink, the copy shares the data blocks until someone writes */
+    if ((out = open(dest, O_WRONLY | O_CREAT | O_EXCL, mode)) != -1) {
+        if (ioctl(out, FICLONE, in) == 0) {
+            ret = _copy_attrs(out, dest, &sb);
+            goto done;
+        }
+
+        close(out);
+        out = -1;
+        unlink(dest);
+    }
+#endif
+
+    /* hard link, only works on the same filesystem */
+    if (link(src, dest) == 0) {
+        ret = 0;
+        goto done;
+    }
+
+#ifdef HAVE_COPY_FILE_RANGE
+    /* let the kernel copy the data without a trip through user space */
+    if ((out = open(dest, O_WRONLY | O_CREAT | O_EXCL, mode)) != -1) {
+        remaining = sb.st_size;
+
+        while (remaining > 0) {
+            if ((r = copy_file_range(in, NULL, out, NULL, remaining, 0)) <= 0) {
+                break;
+            }
+
+            remaining -= r;
+        }
+
+        if (remaining == 0) {
+            ret = _copy_attrs(out, dest, &sb);
+            goto done;
+        }
+
+        close(out);
+        out = -1;
+        unlink(dest);
+    }
+#endif
+
+    /* nothing clever worked, copy it the old fashioned way */
+    close(in);
+    return copyfile(src, dest, true, false);
+
+done:
+    if (out != -1 && close(out) == -1) {
+        ret = -1;
+    }
+
+    close(in);
+    return ret;
+}
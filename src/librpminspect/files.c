@@ -20,9 +20,12 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
 #include <regex.h>
-#include <search.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -36,74 +39,216 @@
 
 #include "rpminspect.h"
 
+/*
+ * The file list of one package.  The list head comes first so the
+ * rpmfile_t handed out by extract_rpm() can be turned back into this.
+ * The entries, their strings and the arrays of table are allocated
+ * from arena and all of them point to the one reference to the package
+ * header held here.
+ */
+struct rpmfile_list {
+    rpmfile_t files;
+    rpmfile_table_t table;
+    struct arena *arena;
+    Header hdr;
+    size_t paths_size;
+    size_t paths_used;
+};
+
+static rpmfile_t *_new_files(Header hdr)
+{
+    struct rpmfile_list *list = NULL;
+
+    list = calloc(1, sizeof(*list));
+    assert(list != NULL);
+    TAILQ_INIT(&list->files);
+    list->arena = arena_new();
+    list->hdr = headerLink(hdr);
+
+    return &list->files;
+}
+
+static inline struct rpmfile_list *_file_list(rpmfile_t *files)
+{
+    return (struct rpmfile_list *) files;
+}
+
+/* Size the file table for up to nfiles files with paths_size bytes of paths */
+static void _init_file_table(struct rpmfile_list *list, size_t nfiles, size_t paths_size)
+{
+    rpmfile_table_t *table = &list->table;
+
+    table->count = 0;
+    table->mode = arena_alloc(list->arena, nfiles * sizeof(*table->mode));
+    table->size = arena_alloc(list->arena, nfiles * sizeof(*table->size));
+    table->path = arena_alloc(list->arena, nfiles * sizeof(*table->path));
+    table->idx = arena_alloc(list->arena, nfiles * sizeof(*table->idx));
+    table->flags = arena_alloc(list->arena, nfiles * sizeof(*table->flags));
+    table->entries = arena_alloc(list->arena, nfiles * sizeof(*table->entries));
+    table->paths = arena_alloc(list->arena, paths_size);
+    list->paths_size = paths_size;
+    list->paths_used = 0;
+    return;
+}
+
+/*
+ * Add file to the table and copy its path into the path pool.  Returns
+ * the slot, or -1 if the table is full.
+ */
+static ssize_t _add_file_table(struct rpmfile_list *list, size_t nfiles, rpmfile_entry_t *file, const char *path)
+{
+    rpmfile_table_t *table = &list->table;
+    size_t slot = table->count;
+    size_t offset = list->paths_used;
+    size_t len = strlen(path) + 1;
+
+    if (slot == nfiles || offset + len > list->paths_size) {
+        return -1;
+    }
+
+    memcpy(table->paths + offset, path, len);
+    table->mode[slot] = file->st.st_mode;
+    table->size[slot] = file->st.st_size;
+    table->path[slot] = offset;
+    table->idx[slot] = file->idx;
+    table->entries[slot] = file;
+    file->localpath = table->paths + offset;
+    list->paths_used += len;
+    table->count++;
+
+    return slot;
+}
+
+/*
+ * Return the files of a package as parallel arrays.  Slot i describes
+ * the i-th entry of files, so a scan that only needs the mode, size or
+ * path of each file can walk the arrays instead of the list, and the
+ * slots can be split into ranges for several workers.  Returns NULL if
+ * files is NULL.
+ */
+const rpmfile_table_t *get_file_table(rpmfile_t *files)
+{
+    if (files == NULL) {
+        return NULL;
+    }
+
+    return &_file_list(files)->table;
+}
+
 void free_files(rpmfile_t *files)
 {
-    rpmfile_entry_t *entry;
+    struct rpmfile_list *list = NULL;
 
     if (files == NULL) {
         return;
     }
 
-    while (!TAILQ_EMPTY(files)) {
-        entry = TAILQ_FIRST(files);
-        TAILQ_REMOVE(files, entry, items);
-        headerFree(entry->rpm_header);
-        free(entry->fullpath);
-        free(entry);
+    list = _file_list(files);
+    headerFree(list->hdr);
+    arena_free(list->arena);
+    free(list);
+}
+
+/*
+ * Name of the directory the payload of pkg is normally unpacked to,
+ * next to the package.  Name the directory the same as the package,
+ * but without the ".rpm".  If some joker hands us a file that doesn't
+ * end in .rpm, slap a ".d" on the end instead.  The caller must free
+ * the returned string.
+ */
+char *get_payload_dir(const char *pkg)
+{
+    char *output_dir = NULL;
+
+    if (strsuffix(pkg, ".rpm")) {
+        xasprintf(&output_dir, "%.*s", (int) strlen(pkg) - 4, pkg);
+    } else {
+        xasprintf(&output_dir, "%s.d", pkg);
     }
 
-    free(files);
+    return output_dir;
+}
+
+/* Open the payload of pkg with libarchive, or return NULL on error */
+static struct archive *_open_payload(const char *pkg)
+{
+    struct archive *archive = NULL;
+
+    archive = archive_read_new();
+    assert(archive != NULL);
+
+#if ARCHIVE_VERSION_NUMBER < 3000000
+    archive_read_support_compression_all(archive);
+#else
+    archive_read_support_filter_all(archive);
+#endif
+    archive_read_support_format_all(archive);
+
+    if (archive_read_open_filename(archive, pkg, 10240) != ARCHIVE_OK) {
+        fprintf(stderr, "*** Unable to open %s with libarchive: %s\n", pkg, archive_error_string(archive));
+        archive_read_free(archive);
+        return NULL;
+    }
+
+    return archive;
 }
 
 /* Extract the RPM, with path "pkg" and extracted header "hdr", to output_dir.
  * Either output_dir or the directory immediately above it must exist.
+ * output_dir is usually get_payload_dir(pkg).
+ *
+ * Only the regular files that one of the inspections selected in ri
+ * will look at are written to disk.  If no selected inspection needs
+ * the payload, it is not read at all and NULL is returned.  If
+ * ri->stream is set, only the list of files is built and nothing is
+ * written to disk.  Use foreach_payload_file() to look at the contents.
  */
-rpmfile_t * extract_rpm(const char *pkg, Header hdr)
+rpmfile_t * extract_rpm(const struct rpminspect *ri, const char *pkg, Header hdr, const char *output_dir)
 {
     rpmtd td = NULL;
     rpm_count_t td_size;
 
     const char *rpm_path;
-    struct hsearch_data path_table;
-    ENTRY e;
-    ENTRY *eptr;
-    int *rpm_indices = NULL;
+    string_map_t *path_table = NULL;
+    void *rpm_index;
+    size_t paths_size = 0;
+    ssize_t slot;
 
-    char *output_dir = NULL;
     struct archive *archive = NULL;
     struct archive_entry *entry;
     const char *archive_path;
     mode_t archive_perm;
     int archive_result;
+    bool extract;
 
     int i;
     rpmfile_entry_t *file_entry;
     rpmfile_t *file_list = NULL;
+    struct arena *arena = NULL;
 
     const int archive_flags = ARCHIVE_EXTRACT_SECURE_NODOTDOT | ARCHIVE_EXTRACT_SECURE_SYMLINKS;
 
+    assert(ri != NULL);
     assert(pkg != NULL);
     assert(hdr != NULL);
+    assert(output_dir != NULL);
 
-    /*
-     * Create an output directory for the rpm payload.
-     * Name the directory the same as the package, but without the ".rpm".
-     * If some joker hands us a file that doesn't end in .rpm, slap a ".d" on the end instead.
-     */
-    if (strsuffix(pkg, ".rpm")) {
-        xasprintf(&output_dir, "%.*s", (int) strlen(pkg) - 4, pkg);
-    } else {
-        xasprintf(&output_dir, "%s.d", pkg);
+    /* Nothing to do if no inspection cares about the payload */
+    if (!inspections_need_payload(ri)) {
+        return NULL;
     }
 
-    if (mkdir(output_dir, S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH) == -1) {
+    /* Create an output directory for the rpm payload */
+    extract = !ri->stream && inspections_want_file(ri, NULL);
+
+    if (extract && mkdir(output_dir, S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH) == -1) {
         fprintf(stderr, "*** Unable to create directory %s: %s\n", output_dir, strerror(errno));
         return NULL;
     }
 
     /* Payload data and header data is not in the same order. In order to match things up,
      * read all of the filenames from the RPM header into a hash table, with the index into
-     * RPM's arrays as the value.
+     * RPM's arrays as the value.  The names belong to td, which is kept until we are done.
      */
     td = rpmtdNew();
     assert(td != NULL);
@@ -115,18 +260,8 @@ rpmfile_t * extract_rpm(const char *pkg, Header hdr)
         goto cleanup;
     }
 
-    /*
-     * Allocate the hash table, and allocate an array of ints to store the index data
-     * that the hash table entries will point to.
-     */
     td_size = rpmtdCount(td);
-    if (hcreate_r(td_size, &path_table) == 0) {
-        fprintf(stderr, "*** Unable to allocate hash table: %s\n", strerror(errno));
-        goto cleanup;
-    }
-
-    rpm_indices = calloc(td_size, sizeof(int));
-    assert(rpm_indices != NULL);
+    path_table = string_map_new(td_size);
 
     for (i = 0; i < (int) td_size; i++) {
         rpm_path = rpmtdNextString(td);
@@ -136,36 +271,19 @@ rpmfile_t * extract_rpm(const char *pkg, Header hdr)
             goto cleanup;
         }
 
-        rpm_indices[i] = i;
-        e.key = (char *) rpm_path;
-        e.data = rpm_indices + i;
-
-        if (hsearch_r(e, ENTER, &eptr, &path_table) == 0) {
-            fprintf(stderr, "*** Error populating hash table: %s\n", strerror(errno));
-            goto cleanup;
-        }
+        string_map_add(path_table, rpm_path, (void *) (intptr_t) i);
+        paths_size += strlen(rpm_path) + 1;
     }
 
     /* Open the file with libarchive */
-    archive = archive_read_new();
-    assert(archive != NULL);
-
-#if ARCHIVE_VERSION_NUMBER < 3000000
-    archive_read_support_compression_all(archive);
-#else
-    archive_read_support_filter_all(archive);
-#endif
-    archive_read_support_format_all(archive);
-
-    if (archive_read_open_filename(archive, pkg, 10240) != ARCHIVE_OK) {
-        fprintf(stderr, "*** Unable to open %s with libarchive: %s\n", pkg, archive_error_string(archive));
+    if ((archive = _open_payload(pkg)) == NULL) {
         goto cleanup;
     }
 
     /* Allocate space for the return value */
-    file_list = calloc(1, sizeof(rpmfile_t));
-    assert(file_list != NULL);
-    TAILQ_INIT(file_list);
+    file_list = _new_files(hdr);
+    arena = _file_list(file_list)->arena;
+    _init_file_table(_file_list(file_list), td_size, paths_size);
 
     while ((archive_result = archive_read_next_header(archive, &entry)) != ARCHIVE_EOF) {
         if (archive_result == ARCHIVE_RETRY) {
@@ -186,8 +304,7 @@ rpmfile_t * extract_rpm(const char *pkg, Header hdr)
             archive_path += 1;
         }
 
-        e.key = (char *) archive_path;
-        if (hsearch_r(e, FIND, &eptr, &path_table) == 0) {
+        if (!string_map_get(path_table, archive_path, &rpm_index)) {
             fprintf(stderr, "*** Payload path %s not in RPM metadata\n", archive_path);
             free_files(file_list);
             file_list = NULL;
@@ -195,33 +312,41 @@ rpmfile_t * extract_rpm(const char *pkg, Header hdr)
         }
 
         /* Create a new rpmfile_entry_t for this file */
-        file_entry = calloc(1, sizeof(rpmfile_entry_t));
-        assert(file_entry != NULL);
-
-        file_entry->rpm_header = headerLink(hdr);
+        file_entry = arena_alloc(arena, sizeof(*file_entry));
+        file_entry->rpm_header = _file_list(file_list)->hdr;
         memcpy(&file_entry->st, archive_entry_stat(entry), sizeof(struct stat));
-        file_entry->idx = *((int *)eptr->data);
+        file_entry->idx = (int) (intptr_t) rpm_index;
+
+        if ((slot = _add_file_table(_file_list(file_list), td_size, file_entry, archive_path)) == -1) {
+            fprintf(stderr, "*** Payload of %s has more entries than RPM metadata\n", pkg);
+            free_files(file_list);
+            file_list = NULL;
+            goto cleanup;
+        }
 
         TAILQ_INSERT_TAIL(file_list, file_entry, items);
 
-        /* Are we extracting this file? */
-        if (!(S_ISREG(file_entry->st.st_mode) || S_ISDIR(file_entry->st.st_mode) || S_ISLNK(file_entry->st.st_mode))) {
+        /*
+         * Are we extracting this file?  Only regular files are looked
+         * at by the inspections, libarchive creates the directories
+         * they live in.
+         */
+        if (!extract || !S_ISREG(file_entry->st.st_mode)) {
+            continue;
+        }
+
+        if (!inspections_want_file(ri, archive_path)) {
             continue;
         }
 
         /* Prepend output_dir to the path name */
-        xasprintf(&file_entry->fullpath, "%s/%s", output_dir, archive_path);
+        file_entry->fullpath = arena_sprintf(arena, "%s/%s", output_dir, archive_path);
         archive_entry_set_pathname(entry, file_entry->fullpath);
 
         /* Ensure the resulting file is user-readable and global-unwritable */
         archive_perm = archive_entry_perm(entry);
         archive_perm |= S_IRUSR;
         archive_perm &= ~S_IWOTH;
-
-        if (S_ISDIR(file_entry->st.st_mode)) {
-            archive_perm |= S_IXUSR;
-        }
-
         archive_entry_set_perm(entry, archive_perm);
 
         /* Write the file to disk */
@@ -231,6 +356,8 @@ rpmfile_t * extract_rpm(const char *pkg, Header hdr)
             file_list = NULL;
             goto cleanup;
         }
+
+        _file_list(file_list)->table.flags[slot] |= RPMFILE_UNPACKED;
     }
 
 cleanup:
@@ -238,49 +365,235 @@ cleanup:
         rpmtdFree(td);
     }
 
-    hdestroy_r(&path_table);
-    free(rpm_indices);
+    string_map_free(path_table);
 
     if (archive != NULL) {
         archive_read_free(archive);
     }
 
-    free(output_dir);
-
     return file_list;
 }
 
-const char * get_file_path(const rpmfile_entry_t *file)
+/*
+ * Read the payload of pkg and call fn for each regular file in files
+ * with the file data in file->contents and file->contents_size.  files
+ * must be the list extract_rpm() returned for pkg, which is in payload
+ * order.  The contents are freed once fn returns.  Every file is handed
+ * to fn even if fn fails for an earlier one.  Returns false if the
+ * payload could not be read or fn returned false for any file.
+ *
+ * If want is not NULL it decides which files are read at all, so large
+ * files nobody looks at are skipped instead of held in memory.  It is
+ * called with a NULL buffer before any data is read, which is the time
+ * to check the path, and then with up to the first FILE_HEAD_SIZE bytes
+ * of the file.  A file is skipped as soon as want returns false.
+ */
+bool foreach_payload_file(const char *pkg, rpmfile_t *files, payload_want_func want, payload_file_func fn, void *data)
 {
-    rpmtd td;
-    const char *result = NULL;
+    struct archive *archive = NULL;
+    struct archive_entry *entry;
+    rpmfile_entry_t *file;
+    int archive_result;
+    unsigned char head[FILE_HEAD_SIZE];
+    unsigned char *buffer = NULL;
+    size_t size;
+    size_t total;
+    ssize_t bytes_read = 0;
+    bool result = true;
 
-    td = rpmtdNew();
-    assert(td != NULL);
+    assert(pkg != NULL);
+    assert(fn != NULL);
+
+    if (files == NULL) {
+        return true;
+    }
+
+    if ((archive = _open_payload(pkg)) == NULL) {
+        return false;
+    }
+
+    file = TAILQ_FIRST(files);
+
+    while ((archive_result = archive_read_next_header(archive, &entry)) != ARCHIVE_EOF) {
+        if (archive_result == ARCHIVE_RETRY) {
+            continue;
+        }
+
+        if (archive_result != ARCHIVE_OK) {
+            fprintf(stderr, "*** Error reading from archive %s: %s\n", pkg, archive_error_string(archive));
+            result = false;
+            break;
+        }
+
+        if (file == NULL) {
+            fprintf(stderr, "*** Payload of %s changed since it was read\n", pkg);
+            result = false;
+            break;
+        }
+
+        if (S_ISREG(file->st.st_mode) && want != NULL && !want(file, NULL, 0, data)) {
+            archive_read_data_skip(archive);
+        } else if (S_ISREG(file->st.st_mode)) {
+            /* read enough to tell what kind of file this is */
+            total = 0;
+
+            while (total < sizeof(head) && (bytes_read = archive_read_data(archive, head + total, sizeof(head) - total)) > 0) {
+                total += bytes_read;
+            }
+
+            if (bytes_read >= 0 && want != NULL && !want(file, head, total, data)) {
+                archive_read_data_skip(archive);
+                file = TAILQ_NEXT(file, items);
+                continue;
+            }
+
+            /*
+             * Read the whole file.  The buffer is one byte larger than
+             * the size in the header so a file that is exactly that size
+             * is read without growing the buffer, but a missing or wrong
+             * size is still handled.
+             */
+            size = ((archive_entry_size(entry) > 0) ? archive_entry_size(entry) : BUFSIZ) + 1;
+
+            if (size <= total) {
+                size = total + 1;
+            }
+
+            buffer = malloc(size);
+            assert(buffer != NULL);
+            memcpy(buffer, head, total);
+
+            while (bytes_read > 0 && (bytes_read = archive_read_data(archive, buffer + total, size - total)) > 0) {
+                total += bytes_read;
+
+                if (total == size) {
+                    size *= 2;
+                    buffer = realloc(buffer, size);
+                    assert(buffer != NULL);
+                }
+            }
+
+            if (bytes_read < 0) {
+                fprintf(stderr, "*** Error reading %s from %s: %s\n", archive_entry_pathname(entry), pkg, archive_error_string(archive));
+                result = false;
+            } else {
+                file->contents = buffer;
+                file->contents_size = total;
+
+                if (!fn(file, data)) {
+                    result = false;
+                }
+
+                file->contents = NULL;
+                file->contents_size = 0;
+            }
+
+            free(buffer);
+            buffer = NULL;
+        }
+
+        file = TAILQ_NEXT(file, items);
+    }
+
+    archive_read_free(archive);
+    return result;
+}
+
+/*
+ * Write the contents of a streamed file to the place in output_dir
+ * extract_rpm() would have unpacked it and set file->fullpath.  For
+ * inspections that need a file on disk rather than data in memory.
+ * files is the list file belongs to and must not be used by another
+ * thread while this runs.
+ */
+bool write_file_contents(const char *output_dir, rpmfile_t *files, rpmfile_entry_t *file)
+{
+    char *fullpath = NULL;
+    char *parent = NULL;
+    const char *localpath = NULL;
+    const unsigned char *data = NULL;
+    size_t written = 0;
+    ssize_t r;
+    mode_t perm;
+    int fd;
+    bool result = false;
+
+    assert(output_dir != NULL);
+    assert(files != NULL);
+    assert(file != NULL);
+    assert(file->contents != NULL);
+
+    if (file->fullpath != NULL) {
+        return true;
+    }
 
-    if (headerGet(file->rpm_header, RPMTAG_FILENAMES, td, HEADERGET_MINMEM | HEADERGET_EXT) != 1) {
-        fprintf(stderr, "*** Unable to read RPMTAG_FILENAMES for %s\n", file->fullpath);
+    if ((localpath = get_file_path(file)) == NULL) {
+        return false;
+    }
+
+    xasprintf(&fullpath, "%s/%s", output_dir, localpath);
+    parent = strdup(fullpath);
+    assert(parent != NULL);
+
+    if (mkdirp(dirname(parent), S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH) == -1) {
         goto cleanup;
     }
 
-    if (rpmtdSetIndex(td, file->idx) == -1) {
-        fprintf(stderr, "*** Invalid file index for %s\n", file->fullpath);
+    /* Ensure the resulting file is user-readable and global-unwritable */
+    perm = (file->st.st_mode & 07777) | S_IRUSR;
+    perm &= ~S_IWOTH;
+
+    if ((fd = open(fullpath, O_WRONLY | O_CREAT | O_TRUNC, perm)) == -1) {
+        fprintf(stderr, "*** Unable to create %s: %s\n", fullpath, strerror(errno));
+        fflush(stderr);
         goto cleanup;
     }
 
-    result = rpmtdGetString(td);
+    data = file->contents;
 
-cleanup:
-    rpmtdFree(td);
+    while (written < file->contents_size) {
+        if ((r = write(fd, data + written, file->contents_size - written)) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            fprintf(stderr, "*** Error writing %s: %s\n", fullpath, strerror(errno));
+            fflush(stderr);
+            break;
+        }
+
+        written += r;
+    }
+
+    close(fd);
 
+    if (written == file->contents_size) {
+        file->fullpath = arena_strdup(_file_list(files)->arena, fullpath);
+        result = true;
+    }
+
+cleanup:
+    free(fullpath);
+    free(parent);
     return result;
 }
 
-bool process_file_path(const rpmfile_entry_t *file, regex_t *include_regex, regex_t *exclude_regex)
+/*
+ * Return the path of the file in the package.  The path is looked up
+ * once by extract_rpm() and belongs to the file entry.
+ */
+const char * get_file_path(const rpmfile_entry_t *file)
 {
-    const char *localpath;
+    assert(file != NULL);
+    return file->localpath;
+}
 
-    localpath = get_file_path(file);
+/*
+ * Return true if the payload path passes the include and exclude
+ * filters.  Either regular expression may be NULL.
+ */
+bool process_path(const char *localpath, regex_t *include_regex, regex_t *exclude_regex)
+{
     assert(localpath != NULL);
 
     /* If include is set, the path must match the regex */
@@ -295,3 +608,13 @@ bool process_file_path(const rpmfile_entry_t *file, regex_t *include_regex, rege
 
     return true;
 }
+
+bool process_file_path(const rpmfile_entry_t *file, regex_t *include_regex, regex_t *exclude_regex)
+{
+    const char *localpath;
+
+    localpath = get_file_path(file);
+    assert(localpath != NULL);
+
+    return process_path(localpath, include_regex, exclude_regex);
+}
@@ -50,6 +50,7 @@ void free_rpminspect(struct rpminspect *ri) {
     free(ri->kojihub);
     free(ri->kojidownload);
     free(ri->worksubdir);
+    free(ri->cachedir);
 
     if (ri->badwords != NULL) {
         while (!TAILQ_EMPTY(ri->badwords)) {
@@ -60,6 +61,9 @@ void free_rpminspect(struct rpminspect *ri) {
         }
     }
 
+    free_licensedb();
+    _free_regex(ri->badwords_regex);
+    scanner_free(ri->badwords_scanner);
     _free_regex(ri->elf_path_include);
     _free_regex(ri->elf_path_exclude);
     _free_regex(ri->manpage_path_include);
@@ -77,6 +81,7 @@ void free_rpminspect(struct rpminspect *ri) {
     free(ri->after_srpm);
 
     free_rpmpeer(ri->peers);
+    free_peer_index(ri->peer_index);
 
     free_results(ri->results);
 
@@ -75,6 +75,7 @@ int init_rpminspect(struct rpminspect *ri, const char *cfgfile) {
     char *badword = NULL;
     string_entry_t *entry = NULL;
     uint64_t tests = 0;
+    int i;
 
     assert(ri != NULL);
     memset(ri, 0, sizeof(*ri));
@@ -92,6 +93,12 @@ int init_rpminspect(struct rpminspect *ri, const char *cfgfile) {
         ri->cfgfile = NULL;
 
         ri->workdir = strdup(DEFAULT_WORKDIR);
+        ri->cachesize = ((uint64_t) DEFAULT_CACHE_SIZE) * 1024 * 1024;
+        ri->download_jobs = DEFAULT_DOWNLOAD_JOBS;
+        ri->download_retries = DEFAULT_DOWNLOAD_RETRIES;
+        ri->jobs = 1;
+        ri->stream = false;
+        ri->inplace = false;
 
         return 0;
     }
@@ -107,6 +114,16 @@ int init_rpminspect(struct rpminspect *ri, const char *cfgfile) {
         ri->workdir = strdup(tmp);
     }
 
+    tmp = iniparser_getstring(cfg, "common:cachedir", NULL);
+    if (tmp == NULL) {
+        ri->cachedir = NULL;
+    } else {
+        ri->cachedir = strdup(tmp);
+    }
+
+    i = iniparser_getint(cfg, "common:cachesize", DEFAULT_CACHE_SIZE);
+    ri->cachesize = ((uint64_t) ((i > 0) ? i : 0)) * 1024 * 1024;
+
     tmp = iniparser_getstring(cfg, "common:licensedb", NULL);
     if (tmp == NULL) {
         ri->licensedb = strdup(LICENSE_DB_FILE);
@@ -128,6 +145,12 @@ int init_rpminspect(struct rpminspect *ri, const char *cfgfile) {
         ri->kojidownload = strdup(tmp);
     }
 
+    i = iniparser_getint(cfg, "koji:download_jobs", DEFAULT_DOWNLOAD_JOBS);
+    ri->download_jobs = (i > 0) ? i : DEFAULT_DOWNLOAD_JOBS;
+
+    i = iniparser_getint(cfg, "koji:download_retries", DEFAULT_DOWNLOAD_RETRIES);
+    ri->download_retries = (i >= 0) ? i : DEFAULT_DOWNLOAD_RETRIES;
+
     tmp = iniparser_getstring(cfg, "tests:badwords", NULL);
     if (tmp == NULL) {
         ri->badwords = NULL;
@@ -142,6 +165,11 @@ int init_rpminspect(struct rpminspect *ri, const char *cfgfile) {
 
         /* convert each word to a regexp and add it to the list */
         while ((badword = strsep(&walk, " \t")) != NULL) {
+            /* runs of whitespace give empty words, which would match anything */
+            if (*badword == '\0') {
+                continue;
+            }
+
             /* create the first pattern with a beginning word boundary */
             entry = calloc(1, sizeof(*entry));
             assert(entry != NULL);
@@ -157,6 +185,17 @@ int init_rpminspect(struct rpminspect *ri, const char *cfgfile) {
 
         /* clean up */
         free(start);
+
+        /*
+         * Prepare them once here rather than for every string checked.
+         * Plain words are matched in one pass with a scanner, anything
+         * else goes through the regular expression engine.
+         */
+        ri->badwords_scanner = scan_bad_words(tmp);
+
+        if (ri->badwords_scanner == NULL && compile_bad_words(ri->badwords, &ri->badwords_regex) != 0) {
+            return -1;
+        }
     }
 
     tmp = iniparser_getstring(cfg, "tests:vendor", NULL);
@@ -205,6 +244,9 @@ int init_rpminspect(struct rpminspect *ri, const char *cfgfile) {
     ri->peers = init_rpmpeer();
     ri->worksubdir = NULL;
     ri->tests = ~tests;
+    ri->jobs = 1;
+    ri->stream = false;
+    ri->inplace = false;
     ri->results = NULL;
 
     /* Clean up */
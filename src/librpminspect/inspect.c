@@ -19,10 +19,16 @@
 #include "config.h"
 
 #include <assert.h>
+#include <fcntl.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include <sys/queue.h>
-#include "inspect.h"
+#include <sys/stat.h>
+#include "rpminspect.h"
 
 /*
  * Ensure the array of inspections is only defined once.
@@ -33,63 +39,732 @@ struct inspect inspections[] = {
       "license",
       true,
       &inspect_license,
+      NULL,
       "Verify the string specified in the License tag of the RPM metadata describes permissible software licenses as defined by the license database. Also checks to see if the License tag contains any unprofessional words as defined in the configuration file." },
 
     { INSPECT_EMPTYRPM,
       "emptyrpm",
       false,
       &inspect_emptyrpm,
+      NULL,
       "Check all binary RPMs in the before and after builds for any empty payloads. Packages that lost payload data from the before build to the after build are reported as well as any packages in the after build that exist but have no payload data." },
 
     { INSPECT_METADATA,
       "metadata",
       false,
       &inspect_metadata,
+      NULL,
       "Perform some RPM header checks. First, check that the Vendor contains the expected string as defined in the configuration file. Second, check that the build host is in the expected subdomain as defined in the configuration file. Third, check the Summary string for any unprofessional words. Fourth, check the Description for any unprofessional words. Lastly, if there is a before build specified, check for differences between the before and after build values of the previous RPM header values and report them." },
 
     { INSPECT_MANPAGE,
       "manpage",
       true,
       &inspect_manpage,
+      &manpage_files,
       "Perform some checks on man pages in the RPM payload. First, check that each man page is compressed. Second, check that each man page contains valid content. Lastly, check that each man page is installed to the correct path." },
 
     { INSPECT_XML,
       "xml",
       true,
       &inspect_xml,
+      &xml_files,
       "Check that XML files included in the RPM payload are well-formed." },
 
     { INSPECT_ELF,
       "elf",
       true,
       &inspect_elf,
+      &elf_files,
       "Perform several checks on ELF files. First, check that ELF objects do not contain an executable stack. Second, check that ELF objects do not contain text relocations. When comparing builds, check that the ELF objects in the after build did not lose a PT_GNU_RELRO segment. Lastly, when comparing builds, check that the ELF objects in the after build did not lose -D_FORTIFY_SOURCE." },
 
-    { 0, NULL, false, NULL, NULL }
+    { 0, NULL, false, NULL, NULL, NULL }
 };
 
+/*
+ * Inspections that need the list of payload files but never look at
+ * the files themselves.  Inspections with per-file hooks need both.
+ */
+#define PAYLOAD_LIST_INSPECTIONS (INSPECT_EMPTYRPM)
+
+/* Will run_inspections() run this inspection? */
+static bool _is_selected(const struct rpminspect *ri, const struct inspect *inspection)
+{
+    /* test not selected by user */
+    if (!(ri->tests & inspection->flag)) {
+        return false;
+    }
+
+    /* inspection requires before/after builds and we have one */
+    if (ri->before == NULL && !inspection->single_build) {
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Return true if any selected inspection needs to know what is in the
+ * payloads.  If not, extract_rpm() does not need to read them at all.
+ */
+bool inspections_need_payload(const struct rpminspect *ri)
+{
+    int i;
+
+    assert(ri != NULL);
+
+    for (i = 0; inspections[i].flag != 0; i++) {
+        if (!_is_selected(ri, &inspections[i])) {
+            continue;
+        }
+
+        if (inspections[i].files != NULL || (inspections[i].flag & PAYLOAD_LIST_INSPECTIONS)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Return true if any selected inspection may look at the payload file
+ * at localpath, i.e. the file passes the include and exclude filters of
+ * an inspection with per-file hooks.  If localpath is NULL, return true
+ * if any selected inspection looks at payload files at all.
+ */
+bool inspections_want_file(const struct rpminspect *ri, const char *localpath)
+{
+    const struct inspect_files *files = NULL;
+    regex_t *include = NULL;
+    regex_t *exclude = NULL;
+    int i;
+
+    assert(ri != NULL);
+
+    for (i = 0; inspections[i].flag != 0; i++) {
+        if ((files = inspections[i].files) == NULL || !_is_selected(ri, &inspections[i])) {
+            continue;
+        }
+
+        if (localpath == NULL) {
+            return true;
+        }
+
+        include = *((regex_t **) (((const char *) ri) + files->path_include));
+        exclude = *((regex_t **) (((const char *) ri) + files->path_exclude));
+
+        if (process_path(localpath, include, exclude)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Internal form of a per-file callback.  item is the position of the
+ * file in the flattened list of "after" files, which callers can use to
+ * keep per-file state.
+ */
+typedef bool (*peer_file_func)(struct rpminspect *, rpmfile_entry_t *, size_t, void *);
+
+/*
+ * State for the parallel form of _walk_peer_files().  The (peer, file)
+ * pairs are flattened into 'files' and handed out to the workers.  Each
+ * worker runs check_fn against its own copy of the struct rpminspect and
+ * the findings for each file are kept in 'results' at the file's index
+ * so they can be added to ri->results in the original order.
+ */
+struct peer_file_jobs {
+    struct rpminspect *ri;
+    peer_file_func check_fn;
+    void *data;
+    struct rpminspect *workers;
+    rpmfile_entry_t **files;
+    results_t **results;
+    bool *passed;
+};
+
+static void _check_peer_file(void *data, unsigned int worker, size_t item) {
+    struct peer_file_jobs *pf = data;
+    struct rpminspect *local = &pf->workers[worker];
+
+    local->results = NULL;
+    pf->passed[item] = pf->check_fn(local, pf->files[item], item, pf->data);
+    pf->results[item] = local->results;
+    return;
+}
+
+static size_t _count_peer_files(const struct rpminspect *ri) {
+    rpmpeer_entry_t *peer;
+    size_t nfiles = 0;
+
+    TAILQ_FOREACH(peer, ri->peers, items) {
+        if (peer->after_files != NULL) {
+            nfiles += get_file_table(peer->after_files)->count;
+        }
+    }
+
+    return nfiles;
+}
+
+static bool _walk_peer_files(struct rpminspect *ri, peer_file_func check_fn, void *data)
+{
+    rpmpeer_entry_t *peer;
+    rpmfile_entry_t *file;
+    const rpmfile_table_t *table;
+    struct peer_file_jobs pf;
+    size_t nfiles = 0;
+    size_t i = 0;
+    bool result = true;
+
+    if (ri->jobs <= 1) {
+        TAILQ_FOREACH(peer, ri->peers, items) {
+            if (peer->after_files == NULL) {
+                continue;
+            }
+
+            TAILQ_FOREACH(file, peer->after_files, items) {
+                if (!check_fn(ri, file, i++, data)) {
+                    result = false;
+                }
+            }
+        }
+
+        return result;
+    }
+
+    /* flatten the peer file lists so workers can claim files by index */
+    if ((nfiles = _count_peer_files(ri)) == 0) {
+        return result;
+    }
+
+    pf.ri = ri;
+    pf.check_fn = check_fn;
+    pf.data = data;
+    pf.files = calloc(nfiles, sizeof(*pf.files));
+    pf.results = calloc(nfiles, sizeof(*pf.results));
+    pf.passed = calloc(nfiles, sizeof(*pf.passed));
+    pf.workers = calloc(ri->jobs, sizeof(*pf.workers));
+    assert(pf.files != NULL);
+    assert(pf.results != NULL);
+    assert(pf.passed != NULL);
+    assert(pf.workers != NULL);
+
+    TAILQ_FOREACH(peer, ri->peers, items) {
+        if (peer->after_files == NULL) {
+            continue;
+        }
+
+        table = get_file_table(peer->after_files);
+        memcpy(pf.files + i, table->entries, table->count * sizeof(*pf.files));
+        i += table->count;
+    }
+
+    for (i = 0; i < ri->jobs; i++) {
+        memcpy(&pf.workers[i], ri, sizeof(*ri));
+    }
+
+    run_jobs(ri->jobs, nfiles, _check_peer_file, &pf);
+
+    /* collect the per-file results in payload order */
+    for (i = 0; i < nfiles; i++) {
+        merge_results(&ri->results, pf.results[i]);
+
+        if (!pf.passed[i]) {
+            result = false;
+        }
+    }
+
+    free(pf.files);
+    free(pf.results);
+    free(pf.passed);
+    free(pf.workers);
+
+    return result;
+}
+
+struct peer_file_check {
+    foreach_peer_file_func check_fn;
+};
+
+static bool _check_one_file(struct rpminspect *ri, rpmfile_entry_t *file,
+                            size_t item __attribute__((unused)), void *data) {
+    struct peer_file_check *pc = data;
+
+    return pc->check_fn(ri, file);
+}
+
 /*
  * Inspect each "after" file in each peer of an inspection.
  * If the foreach_peer_file_func returns false for any file, the result will be false.
  * foreach_peer_file_func is run on each file even if an earlier file fails. This allows
  * for multiple errors to be collected for a single inspection.
+ *
+ * When ri->jobs is greater than one, files are checked concurrently and
+ * check_fn must be safe to call from multiple threads.  Results are still
+ * reported in payload order.
  */
 bool foreach_peer_file(struct rpminspect *ri, foreach_peer_file_func check_fn)
 {
-    rpmpeer_entry_t *peer;
-    rpmfile_entry_t *file;
-    bool result = true;
+    struct peer_file_check pc;
 
     assert(ri != NULL);
     assert(check_fn != NULL);
 
+    pc.check_fn = check_fn;
+    return _walk_peer_files(ri, _check_one_file, &pc);
+}
+
+/* Classify the first bytes of a regular file */
+static unsigned int _get_buffer_kinds(const unsigned char *buffer, size_t size) {
+    unsigned int kinds = FILE_KIND_REGULAR;
+
+    if (size >= SELFMAG && !memcmp(buffer, ELFMAG, SELFMAG)) {
+        kinds |= FILE_KIND_ELF;
+    } else if (is_xml_prelude(buffer, size)) {
+        kinds |= FILE_KIND_XML;
+    }
+
+    return kinds;
+}
+
+/*
+ * Determine which FILE_KIND_* values describe a payload file.  An
+ * extracted file is only opened if the caller wants to know about a
+ * kind that depends on the file contents.
+ */
+static unsigned int _get_file_kinds(const rpmfile_entry_t *file, unsigned int wanted) {
+    unsigned char buffer[FILE_HEAD_SIZE];
+    ssize_t bytes_read;
+    int fd;
+
+    if (!(wanted & (FILE_KIND_ELF | FILE_KIND_XML))) {
+        return FILE_KIND_REGULAR;
+    }
+
+    if (file->contents != NULL) {
+        return _get_buffer_kinds(file->contents, file->contents_size);
+    }
+
+    if ((fd = open(file->fullpath, O_RDONLY)) == -1) {
+        return FILE_KIND_REGULAR;
+    }
+
+    bytes_read = read(fd, buffer, sizeof(buffer));
+    close(fd);
+
+    if (bytes_read <= 0) {
+        return FILE_KIND_REGULAR;
+    }
+
+    return _get_buffer_kinds(buffer, bytes_read);
+}
+
+/*
+ * One selected inspection handed to run_inspections() workers.  Each
+ * driver gets its own copy of the struct rpminspect with an empty
+ * results list so concurrently running drivers never share a list.
+ * Inspections that register per-file hooks are 'fused' and share a
+ * single walk of the payload instead of running their own driver.
+ */
+struct inspection_job {
+    struct inspect *inspection;
+    results_t *results;
+    bool passed;
+    bool fused;
+};
+
+struct inspection_jobs {
+    struct rpminspect *ri;
+    struct inspection_job *jobs;
+    size_t njobs;
+    size_t *runnable;
+    size_t nrunnable;
+    size_t nfused;
+};
+
+/* State for a fused inspection during the shared payload walk */
+struct fused_inspection {
+    struct inspection_job *job;
+    const struct inspect_files *files;
+    regex_t *include;
+    regex_t *exclude;
+    results_t **results;       /* findings, indexed by payload file */
+};
+
+struct fused_walk {
+    struct fused_inspection *fused;
+    size_t nfused;
+    unsigned int kinds;        /* every kind wanted by any inspection */
+};
+
+/*
+ * Hand one payload file to every fused inspection that wants it.  peer
+ * is the package being streamed, if any, and is only used to write out
+ * a streamed file for inspections that need a path.
+ */
+static void _fused_file_check(struct rpminspect *ri, rpmfile_entry_t *file, size_t item,
+                              struct fused_walk *fw, rpmpeer_entry_t *peer) {
+    struct fused_inspection *fi = NULL;
+    results_t *saved = ri->results;
+    const char *localpath = NULL;
+    unsigned int kinds;
+    size_t i;
+
+    if ((!file->fullpath && !file->contents) || !S_ISREG(file->st.st_mode)) {
+        return;
+    }
+
+    if ((localpath = get_file_path(file)) == NULL) {
+        return;
+    }
+
+    kinds = _get_file_kinds(file, fw->kinds);
+
+    for (i = 0; i < fw->nfused; i++) {
+        fi = &fw->fused[i];
+
+        if (!(fi->files->kinds & kinds)) {
+            continue;
+        }
+
+        if (!process_path(localpath, fi->include, fi->exclude)) {
+            continue;
+        }
+
+        if (fi->files->needs_path && file->fullpath == NULL && !write_file_contents(peer->after_root, peer->after_files, file)) {
+            __atomic_store_n(&fi->job->passed, false, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        ri->results = NULL;
+
+        if (!fi->files->driver(ri, file, localpath)) {
+            __atomic_store_n(&fi->job->passed, false, __ATOMIC_RELAXED);
+        }
+
+        fi->results[item] = ri->results;
+    }
+
+    ri->results = saved;
+    return;
+}
+
+static bool _fused_file(struct rpminspect *ri, rpmfile_entry_t *file, size_t item, void *data) {
+    _fused_file_check(ri, file, item, data, NULL);
+    return true;
+}
+
+/*
+ * State for walking streamed payloads.  Each package is read by one
+ * worker, so the packages are handed out as jobs.  offsets[] holds the
+ * index of the first file of each package in the flattened file list.
+ */
+struct fused_stream_jobs {
+    struct fused_walk *fw;
+    struct rpminspect *workers;
+    rpmpeer_entry_t **peers;
+    size_t *offsets;
+};
+
+/* Where the payload walk of one package is */
+struct fused_stream {
+    struct rpminspect *ri;
+    struct fused_walk *fw;
+    rpmpeer_entry_t *peer;
+    rpmfile_entry_t *cursor;
+    size_t item;
+};
+
+static bool _fused_stream_file(rpmfile_entry_t *file, void *data) {
+    struct fused_stream *fs = data;
+
+    /* only regular files are handed to us, keep the index in step */
+    while (fs->cursor != file) {
+        fs->cursor = TAILQ_NEXT(fs->cursor, items);
+        fs->item++;
+    }
+
+    _fused_file_check(fs->ri, file, fs->item, fs->fw, fs->peer);
+    return true;
+}
+
+/*
+ * Decide whether a streamed file is read at all: first by its path
+ * alone, then by the kind its first bytes show.  Files no fused
+ * inspection wants are skipped without reading them into memory.
+ */
+static bool _fused_stream_want(rpmfile_entry_t *file, const unsigned char *head, size_t size, void *data) {
+    struct fused_stream *fs = data;
+    struct fused_inspection *fi = NULL;
+    const char *localpath = NULL;
+    unsigned int kinds;
+    size_t i;
+
+    if ((localpath = get_file_path(file)) == NULL) {
+        return false;
+    }
+
+    if (head == NULL) {
+        return inspections_want_file(fs->ri, localpath);
+    }
+
+    kinds = (fs->fw->kinds & (FILE_KIND_ELF | FILE_KIND_XML)) ? _get_buffer_kinds(head, size) : FILE_KIND_REGULAR;
+
+    for (i = 0; i < fs->fw->nfused; i++) {
+        fi = &fs->fw->fused[i];
+
+        if ((fi->files->kinds & kinds) && process_path(localpath, fi->include, fi->exclude)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void _fused_stream_peer(void *data, unsigned int worker, size_t item) {
+    struct fused_stream_jobs *sj = data;
+    rpmpeer_entry_t *peer = sj->peers[item];
+    struct fused_stream fs;
+    struct fused_inspection *fi = NULL;
+    char *msg = NULL;
+    size_t i;
+
+    fs.ri = &sj->workers[worker];
+    fs.fw = sj->fw;
+    fs.peer = peer;
+    fs.cursor = TAILQ_FIRST(peer->after_files);
+    fs.item = sj->offsets[item];
+
+    if (foreach_payload_file(peer->after_rpm, peer->after_files, _fused_stream_want, _fused_stream_file, &fs)) {
+        return;
+    }
+
+    fprintf(stderr, "*** Unable to inspect the payload of %s\n", peer->after_rpm);
+    fflush(stderr);
+
+    /*
+     * The fused inspections did not see every file of this package, so
+     * none of them can pass.  The finding goes with the first file of
+     * the package, whose slot only this worker writes.
+     */
+    xasprintf(&msg, "Unable to read the payload of %s, files in it were not inspected", peer->after_rpm);
+
+    for (i = 0; i < sj->fw->nfused; i++) {
+        fi = &sj->fw->fused[i];
+        __atomic_store_n(&fi->job->passed, false, __ATOMIC_RELAXED);
+        add_result(&fi->results[sj->offsets[item]], RESULT_BAD, NOT_WAIVABLE, fi->files->header, msg, NULL, REMEDY_PAYLOAD);
+    }
+
+    free(msg);
+    return;
+}
+
+/*
+ * Stream the payload of every "after" package through the fused
+ * inspections instead of reading unpacked files.  Packages are read
+ * concurrently when ri->jobs allows it.
+ */
+static void _stream_peer_files(struct rpminspect *ri, struct fused_walk *fw) {
+    struct fused_stream_jobs sj;
+    rpmpeer_entry_t *peer;
+    size_t npeers = 0;
+    size_t offset = 0;
+    unsigned int i;
+
     TAILQ_FOREACH(peer, ri->peers, items) {
-        TAILQ_FOREACH(file, peer->after_files, items) {
-            if (!check_fn(ri, file)) {
-                result = false;
-            }
+        if (peer->after_files != NULL && !TAILQ_EMPTY(peer->after_files)) {
+            npeers++;
+        }
+    }
+
+    if (npeers == 0) {
+        return;
+    }
+
+    sj.fw = fw;
+    sj.peers = calloc(npeers, sizeof(*sj.peers));
+    sj.offsets = calloc(npeers, sizeof(*sj.offsets));
+    sj.workers = calloc(ri->jobs > 0 ? ri->jobs : 1, sizeof(*sj.workers));
+    assert(sj.peers != NULL);
+    assert(sj.offsets != NULL);
+    assert(sj.workers != NULL);
+    npeers = 0;
+
+    TAILQ_FOREACH(peer, ri->peers, items) {
+        if (peer->after_files == NULL) {
+            continue;
+        }
+
+        if (!TAILQ_EMPTY(peer->after_files)) {
+            sj.peers[npeers] = peer;
+            sj.offsets[npeers] = offset;
+            npeers++;
+        }
+
+        offset += get_file_table(peer->after_files)->count;
+    }
+
+    for (i = 0; i < (ri->jobs > 0 ? ri->jobs : 1); i++) {
+        memcpy(&sj.workers[i], ri, sizeof(*ri));
+    }
+
+    run_jobs(ri->jobs, npeers, _fused_stream_peer, &sj);
+
+    free(sj.peers);
+    free(sj.offsets);
+    free(sj.workers);
+    return;
+}
+
+/*
+ * Walk the payload once for every fused inspection, handing each file
+ * to the inspections that want it.  Findings are kept per inspection
+ * so each one still reports its results together and in payload order.
+ */
+static void _run_fused_inspections(struct inspection_jobs *ij) {
+    struct rpminspect local;
+    struct fused_walk fw;
+    struct fused_inspection *fi = NULL;
+    struct inspection_job *job = NULL;
+    size_t nfiles;
+    size_t i;
+    size_t j;
+
+    memcpy(&local, ij->ri, sizeof(local));
+    local.results = NULL;
+
+    nfiles = _count_peer_files(&local);
+    fw.fused = calloc(ij->nfused, sizeof(*fw.fused));
+    assert(fw.fused != NULL);
+    fw.nfused = 0;
+    fw.kinds = 0;
+
+    for (i = 0; i < ij->njobs; i++) {
+        job = &ij->jobs[i];
+
+        if (!job->fused) {
+            continue;
+        }
+
+        if (job->inspection->files->init != NULL && !job->inspection->files->init()) {
+            job->passed = false;
+            continue;
+        }
+
+        fi = &fw.fused[fw.nfused++];
+        fi->job = job;
+        fi->files = job->inspection->files;
+        fi->include = *((regex_t **) (((char *) &local) + fi->files->path_include));
+        fi->exclude = *((regex_t **) (((char *) &local) + fi->files->path_exclude));
+        fi->results = calloc(nfiles, sizeof(*fi->results));
+        assert(nfiles == 0 || fi->results != NULL);
+        fw.kinds |= fi->files->kinds;
+    }
+
+    if (fw.nfused > 0 && nfiles > 0) {
+        if (local.stream) {
+            _stream_peer_files(&local, &fw);
+        } else {
+            _walk_peer_files(&local, _fused_file, &fw);
+        }
+    }
+
+    for (i = 0; i < fw.nfused; i++) {
+        fi = &fw.fused[i];
+
+        for (j = 0; j < nfiles; j++) {
+            merge_results(&fi->job->results, fi->results[j]);
+        }
+
+        if (fi->files->free != NULL) {
+            fi->files->free();
+        }
+
+        free(fi->results);
+    }
+
+    free(fw.fused);
+    return;
+}
+
+static void _run_inspection(void *data, unsigned int worker __attribute__((unused)), size_t item) {
+    struct inspection_jobs *ij = data;
+    struct inspection_job *job = NULL;
+    struct rpminspect local;
+
+    job = &ij->jobs[ij->runnable[item]];
+    memcpy(&local, ij->ri, sizeof(local));
+    local.results = NULL;
+
+    job->passed = job->inspection->driver(&local);
+    job->results = local.results;
+    return;
+}
+
+/*
+ * Run the inspections selected in ri->tests.  Inspections that look at
+ * payload files through struct inspect_files share one walk of the
+ * payload, which runs first and spreads its files or packages over
+ * ri->jobs threads.  The other inspections then run, up to ri->jobs of
+ * them at the same time.  The two never overlap, so ri->jobs is the
+ * limit on the total number of threads.  Results from each
+ * inspection are appended to ri->results in the order of the
+ * inspections[] array once all of the drivers have finished, so the
+ * output matches a serial run no matter how many jobs were used.
+ * Returns false if any inspection failed.
+ */
+bool run_inspections(struct rpminspect *ri)
+{
+    struct inspection_jobs ij;
+    size_t i;
+    bool result = true;
+
+    assert(ri != NULL);
+
+    memset(&ij, 0, sizeof(ij));
+    ij.ri = ri;
+
+    for (i = 0; inspections[i].flag != 0; i++) {
+        if (!_is_selected(ri, &inspections[i])) {
+            continue;
+        }
+
+        ij.jobs = realloc(ij.jobs, (ij.njobs + 1) * sizeof(*ij.jobs));
+        assert(ij.jobs != NULL);
+        ij.jobs[ij.njobs].inspection = &inspections[i];
+        ij.jobs[ij.njobs].results = NULL;
+        ij.jobs[ij.njobs].passed = true;
+        ij.jobs[ij.njobs].fused = (inspections[i].files != NULL);
+        ij.njobs++;
+    }
+
+    ij.runnable = calloc(ij.njobs + 1, sizeof(*ij.runnable));
+    assert(ij.runnable != NULL);
+
+    for (i = 0; i < ij.njobs; i++) {
+        if (ij.jobs[i].fused) {
+            ij.nfused++;
+        } else {
+            ij.runnable[ij.nrunnable++] = i;
+        }
+    }
+
+    if (ij.nfused > 0) {
+        _run_fused_inspections(&ij);
+    }
+
+    run_jobs(ri->jobs, ij.nrunnable, _run_inspection, &ij);
+
+    for (i = 0; i < ij.njobs; i++) {
+        merge_results(&ri->results, ij.jobs[i].results);
+
+        if (!ij.jobs[i].passed) {
+            result = false;
         }
     }
 
+    free(ij.runnable);
+    free(ij.jobs);
     return result;
 }
@@ -26,6 +26,7 @@
 #include <libelf.h>
 #include <libkmod.h>
 #include "types.h"
+#include "readelf.h"
 
 #ifndef _LIBRPMINSPECT_INSPECT_H
 #define _LIBRPMINSPECT_INSPECT_H
@@ -43,25 +44,41 @@
  * driver simple.
  */
 
+/*
+ * Kinds of payload files an inspection can ask for in its struct
+ * inspect_files.  FILE_KIND_REGULAR is every extracted regular file,
+ * the others are regular files whose contents look like that type.
+ */
+#define FILE_KIND_REGULAR   (1 << 0)
+#define FILE_KIND_ELF       (1 << 1)
+#define FILE_KIND_XML       (1 << 2)
+
+/* How much of a file is looked at to tell its kind */
+#define FILE_HEAD_SIZE      32
+
 /* inspect.c */
 typedef bool (*foreach_peer_file_func)(struct rpminspect *, rpmfile_entry_t *);
 bool foreach_peer_file(struct rpminspect *, foreach_peer_file_func);
+bool run_inspections(struct rpminspect *);
+bool inspections_need_payload(const struct rpminspect *);
+bool inspections_want_file(const struct rpminspect *, const char *);
 
 /* inspect_elf.c */
 void init_elf_data(void);
 void free_elf_data(void);
-bool has_executable_program(Elf *);
-bool is_execstack_present(Elf *);
-uint64_t get_execstack_flags(Elf *);
-bool is_execstack_valid(Elf *, uint64_t);
-bool is_stack_executable(Elf *, uint64_t);
-bool has_textrel(Elf *);
-bool has_relro(Elf *);
-bool has_bind_now(Elf *);
+bool has_executable_program(const struct elf_summary *);
+bool is_execstack_present(const struct elf_summary *);
+uint64_t get_execstack_flags(const struct elf_summary *);
+bool is_execstack_valid(const struct elf_summary *, uint64_t);
+bool is_stack_executable(const struct elf_summary *, uint64_t);
+bool has_textrel(const struct elf_summary *);
+bool has_relro(const struct elf_summary *);
+bool has_bind_now(const struct elf_summary *);
 string_list_t * get_fortified_symbols(Elf *);
 string_list_t * get_fortifiable_symbols(Elf *);
 bool is_pic_ok(Elf *);
 bool inspect_elf(struct rpminspect *);
+extern const struct inspect_files elf_files;
 
 /* inspect_kernel.c */
 bool compare_module_parameters(const struct kmod_list *, const struct kmod_list *, string_list_t **);
@@ -78,7 +95,10 @@ bool inspect_emptyrpm(struct rpminspect *);
 
 /* inspect_xml.c */
 bool is_xml_well_formed(const char *, char **);
+bool is_xml_well_formed_memory(const char *, size_t, const char *, char **);
+bool is_xml_prelude(const unsigned char *, size_t);
 bool inspect_xml(struct rpminspect *);
+extern const struct inspect_files xml_files;
 
 /* inspect_manpage.c */
 bool inspect_manpage_alloc(void);
@@ -86,6 +106,7 @@ void inspect_manpage_free(void);
 bool inspect_manpage_path(const char *);
 char * inspect_manpage_validity(const char *);
 bool inspect_manpage(struct rpminspect *);
+extern const struct inspect_files manpage_files;
 
 /* inspect_metadata.c */
 bool inspect_metadata(struct rpminspect *);
@@ -20,8 +20,8 @@
 
 #include <assert.h>
 #include <fcntl.h>
-#include <search.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <sys/queue.h>
 #include <sys/types.h>
 
@@ -41,7 +41,7 @@ bool is_pic_reloc(Elf64_Half, Elf64_Xword);
 
 /* Used by the fortified symbol checks */
 static string_list_t *fortifiable = NULL;
-static struct hsearch_data *fortifiable_table = NULL;
+static string_map_t *fortifiable_table = NULL;
 
 static bool is_fortified(const char *symbol);
 static bool is_fortifiable(const char *symbol);
@@ -59,8 +59,6 @@ void init_elf_data(void)
     string_entry_t *iter;
     size_t symbol_len;
     size_t nentries;
-    ENTRY e;
-    ENTRY *eptr;
 
     /*
      * Use libdl to get the path to libc.so.6 so we can open it.
@@ -98,7 +96,7 @@ void init_elf_data(void)
     libc_fortified = get_elf_exported_functions(libc_elf, is_fortified);
 
     if (libc_fortified == NULL) {
-        elf_end(libc_elf);
+        end_elf(libc_elf);
         close(libc_fd);
         return;
     }
@@ -130,35 +128,23 @@ void init_elf_data(void)
     }
 
     list_free(libc_fortified, NULL);
-    elf_end(libc_elf);
+    end_elf(libc_elf);
     close(libc_fd);
 
     /* The fortifiable tailq is to keep track of what all's been malloced.
      * Copy into a hash table for fast lookups.
      */
-    fortifiable_table = calloc(1, sizeof(*fortifiable_table));
-    assert(fortifiable_table != NULL);
-
-    if (hcreate_r(nentries, fortifiable_table) == 0) {
-        free(fortifiable_table);
-        fortifiable_table = NULL;
-        return;
-    }
+    fortifiable_table = string_map_new(nentries);
 
     TAILQ_FOREACH(iter, fortifiable, items) {
-        e.key = iter->data;
-        e.data = iter->data;
-        hsearch_r(e, ENTER, &eptr, fortifiable_table);
+        string_map_add(fortifiable_table, iter->data, iter->data);
     }
 }
 
 void free_elf_data(void)
 {
-    if (fortifiable_table != NULL) {
-        hdestroy_r(fortifiable_table);
-        free(fortifiable_table);
-        fortifiable_table = NULL;
-    }
+    string_map_free(fortifiable_table);
+    fortifiable_table = NULL;
 
     if (fortifiable != NULL) {
         list_free(fortifiable, free);
@@ -171,16 +157,14 @@ void free_elf_data(void)
  * header for ET_EXEC and ET_DYN, and in the .note.GNU-stack
  * section for ET_REL
  */
-bool is_execstack_present(Elf *elf)
+bool is_execstack_present(const struct elf_summary *elf)
 {
-    GElf_Phdr phdr;
-
-    switch (get_elf_type(elf)) {
+    switch (elf->type) {
         case ET_REL:
-            return have_elf_section(elf, SHT_PROGBITS, ".note.GNU-stack");
+            return elf->stack_note;
         case ET_EXEC:
         case ET_DYN:
-            return (get_elf_phdr(elf, PT_GNU_STACK, &phdr) != NULL);
+            return elf->stack_phdr;
         default:
             return false;
     }
@@ -190,28 +174,14 @@ bool is_execstack_present(Elf *elf)
  * This is either the p_flags from the GNU_STACK program header entry
  * or the sh_flags from the .note.GNU-stack section.
  */
-uint64_t get_execstack_flags(Elf *elf)
+uint64_t get_execstack_flags(const struct elf_summary *elf)
 {
-    GElf_Phdr phdr;
-    Elf_Scn *scn;
-    GElf_Shdr shdr;
-
-    switch (get_elf_type(elf)) {
+    switch (elf->type) {
         case ET_REL:
-            scn = get_elf_section(elf, SHT_PROGBITS, ".note.GNU-stack", NULL, &shdr);
-
-            if (scn == NULL) {
-                return 0;
-            }
-
-            return shdr.sh_flags;
+            return elf->stack_note ? elf->stack_note_flags : 0;
         case ET_EXEC:
         case ET_DYN:
-            if (get_elf_phdr(elf, PT_GNU_STACK, &phdr) == NULL) {
-                return 0;
-            }
-
-            return phdr.p_flags;
+            return elf->stack_phdr ? elf->stack_phdr_flags : 0;
         default:
             return 0;
     }
@@ -221,29 +191,20 @@ uint64_t get_execstack_flags(Elf *elf)
  * This is a way of filtering out the ET_REL DWARF objects in /usr/lib/debug/.dwz,
  * which have no executable code.
  */
-bool has_executable_program(Elf *elf)
+bool has_executable_program(const struct elf_summary *elf)
 {
-    Elf_Scn *scn = NULL;
-    GElf_Shdr shdr;
-
-    while ((scn = get_elf_section(elf, SHT_PROGBITS, NULL, scn, &shdr)) != NULL) {
-        if (shdr.sh_flags & SHF_EXECINSTR) {
-            return true;
-        }
-    }
-
-    return false;
+    return elf->executable_code;
 }
 
 /* Check whether the given object's execstack information makes sense.
  * For ET_EXEC and ET_DYN, PF_W and PF_R must be set. For ET_REL,
  * nothing other than SHF_EXECINSTR should be set.
- * flags is the value returned by get_execstack_flags. The Elf pointer
+ * flags is the value returned by get_execstack_flags. The summary
  * is still required to figure out which flags they are.
  */
-bool is_execstack_valid(Elf *elf, uint64_t flags)
+bool is_execstack_valid(const struct elf_summary *elf, uint64_t flags)
 {
-    switch (get_elf_type(elf)) {
+    switch (elf->type) {
         case ET_REL:
             /* Mask out SHF_EXECINSTR, check that nothing else is set */
             return !(flags & ~(SHF_EXECINSTR));
@@ -257,9 +218,9 @@ bool is_execstack_valid(Elf *elf, uint64_t flags)
 }
 
 /* Like above, but return true if the relevant executable bit is set */
-bool is_stack_executable(Elf *elf, uint64_t flags)
+bool is_stack_executable(const struct elf_summary *elf, uint64_t flags)
 {
-    switch (get_elf_type(elf)) {
+    switch (elf->type) {
         case ET_REL:
             return flags & SHF_EXECINSTR;
         case ET_EXEC:
@@ -271,22 +232,21 @@ bool is_stack_executable(Elf *elf, uint64_t flags)
 }
 
 /* Return true if this object has a DT_TEXTREL entry */
-bool has_textrel(Elf *elf)
+bool has_textrel(const struct elf_summary *elf)
 {
-    return have_dynamic_tag(elf, DT_TEXTREL);
+    return elf->textrel;
 }
 
 /* true if there is a PT_GNU_RELRO phdr */
-bool has_relro(Elf *elf)
+bool has_relro(const struct elf_summary *elf)
 {
-    GElf_Phdr phdr;
-    return (get_elf_phdr(elf, PT_GNU_RELRO, &phdr) != NULL);
+    return elf->relro;
 }
 
 /* true if there is a DT_BIND_NOW entry */
-bool has_bind_now(Elf *elf)
+bool has_bind_now(const struct elf_summary *elf)
 {
-    return have_dynamic_tag(elf, DT_BIND_NOW);
+    return elf->bind_now;
 }
 
 static bool is_fortified(const char *symbol)
@@ -303,11 +263,11 @@ static bool is_fortified(const char *symbol)
 
 static bool is_fortifiable(const char *symbol)
 {
-    ENTRY e;
-    ENTRY *eptr;
-    e.key = (char *) symbol;
-    hsearch_r(e, FIND, &eptr, fortifiable_table);
-    return eptr != NULL;
+    if (fortifiable_table == NULL) {
+        return false;
+    }
+
+    return string_map_get(fortifiable_table, symbol, NULL);
 }
 
 /* Return a list of fortified symbols found linked in the given ELF object */
@@ -446,13 +406,12 @@ bool is_pic_ok(Elf *elf)
     return true;
 }
 
-static const char * pflags_to_str(uint64_t flags)
+/* output needs enough space for RWX?\0 */
+static const char * pflags_to_str(uint64_t flags, char output[5])
 {
-    /* enough space for RWX?\0 */
-    static char output[5];
     char *current = output;
 
-    memset(output, 0, sizeof(output));
+    memset(output, 0, 5);
 
     if (flags & PF_R) {
         *current = 'R';
@@ -477,19 +436,20 @@ static const char * pflags_to_str(uint64_t flags)
     return output;
 }
 
-static bool inspect_elf_execstack(struct rpminspect *ri, Elf *elf, const char *localpath, const char *arch)
+static bool inspect_elf_execstack(struct rpminspect *ri, const struct elf_summary *elf, const char *localpath, const char *arch)
 {
     Elf64_Half elf_type;
     uint64_t execstack_flags;
     bool result = false;
     char *msg = NULL;
+    char pflags[5];
 
     /* If there is no executable code, there is no executable stack */
     if (!has_executable_program(elf)) {
         return true;
     }
 
-    elf_type = get_elf_type(elf);
+    elf_type = elf->type;
 
     /* Check if execstack information is present */
     if (!is_execstack_present(elf)) {
@@ -516,7 +476,7 @@ static bool inspect_elf_execstack(struct rpminspect *ri, Elf *elf, const char *l
 
             add_result(&ri->results, RESULT_BAD, WAIVABLE_BY_SECURITY, HEADER_ELF, msg, NULL, REMEDY_ELF_EXECSTACK_INVALID);
         } else {
-            xasprintf(&msg, "File %s has unrecognized GNU_STACK '%s' (expected RW or RWE) on %s", localpath, pflags_to_str(execstack_flags), arch);
+            xasprintf(&msg, "File %s has unrecognized GNU_STACK '%s' (expected RW or RWE) on %s", localpath, pflags_to_str(execstack_flags, pflags), arch);
 
             add_result(&ri->results, RESULT_BAD, WAIVABLE_BY_SECURITY, HEADER_ELF, msg, NULL, REMEDY_ELF_EXECSTACK_INVALID);
         }
@@ -547,42 +507,40 @@ cleanup:
     return result;
 }
 
-static bool _elf_driver(struct rpminspect *ri, rpmfile_entry_t *file)
+/* Run the ELF checks on a payload file that passed the path filters */
+static bool _elf_file_driver(struct rpminspect *ri, rpmfile_entry_t *file, const char *localpath)
 {
-    const char *localpath;
     const char *arch;
     Elf *elf;
     int elf_fd;
+    struct elf_summary summary;
     bool result = true;
     char *msg = NULL;
 
-    if (!file->fullpath || !S_ISREG(file->st.st_mode)) {
-        return true;
+    /* Is it an elf file? */
+    if (file->contents != NULL) {
+        elf = get_elf_memory(file->contents, file->contents_size);
+        elf_fd = -1;
+    } else {
+        elf = get_elf(file->fullpath, &elf_fd);
     }
 
-    if (!process_file_path(file, ri->elf_path_include, ri->elf_path_exclude)) {
+    if (!elf) {
         return true;
     }
 
-    localpath = get_file_path(file);
-
-    if (!localpath) {
-        return true;
-    }
-
-    /* Is it an elf file? */
-    elf = get_elf(file->fullpath, &elf_fd);
-    if (!elf) {
-        return true;
+    /* read everything the checks below need in one pass */
+    if (!get_elf_summary(elf, &summary)) {
+        goto done;
     }
 
     arch = headerGetString(file->rpm_header, RPMTAG_ARCH);
 
-    if (!inspect_elf_execstack(ri, elf, localpath, arch)) {
+    if (!inspect_elf_execstack(ri, &summary, localpath, arch)) {
         result = false;
     }
 
-    if (has_textrel(elf)) {
+    if (has_textrel(&summary)) {
         xasprintf(&msg, "%s has TEXTREL relocations on %s", localpath, arch);
 
         add_result(&ri->results, RESULT_BAD, WAIVABLE_BY_SECURITY, HEADER_ELF, msg, NULL, REMEDY_ELF_TEXTREL);
@@ -592,11 +550,54 @@ static bool _elf_driver(struct rpminspect *ri, rpmfile_entry_t *file)
 
     /* TODO: comparison tests: PT_GNU_RELRO, fortified symbols */
 
-    elf_end(elf);
-    close(elf_fd);
+done:
+    end_elf(elf);
+
+    if (elf_fd != -1) {
+        close(elf_fd);
+    }
+
     return result;
 }
 
+static bool _elf_driver(struct rpminspect *ri, rpmfile_entry_t *file)
+{
+    const char *localpath;
+
+    if (!file->fullpath || !S_ISREG(file->st.st_mode)) {
+        return true;
+    }
+
+    if (!process_file_path(file, ri->elf_path_include, ri->elf_path_exclude)) {
+        return true;
+    }
+
+    localpath = get_file_path(file);
+
+    if (!localpath) {
+        return true;
+    }
+
+    return _elf_file_driver(ri, file, localpath);
+}
+
+static bool _init_elf_files(void)
+{
+    init_elf_data();
+    return true;
+}
+
+const struct inspect_files elf_files = {
+    FILE_KIND_ELF,
+    HEADER_ELF,
+    offsetof(struct rpminspect, elf_path_include),
+    offsetof(struct rpminspect, elf_path_exclude),
+    false,
+    _init_elf_files,
+    free_elf_data,
+    _elf_file_driver
+};
+
 bool inspect_elf(struct rpminspect *ri)
 {
     bool result;
@@ -19,41 +19,342 @@
 #include "config.h"
 
 #include <assert.h>
-#include <errno.h>
+#include <ctype.h>
 #include <stdbool.h>
 #include <string.h>
-#include <sys/mman.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <stdarg.h>
-#include <json.h>
+#include <pthread.h>
 #include "rpminspect.h"
 
-/* Local globals */
-static struct json_object *licdb = NULL;
-static char *licdata = NULL;
-static int liclen = 0;
+/*
+ * Local globals.  The license database is opened the first time a
+ * License tag is checked and kept until free_licensedb() is called.
+ * licdb_lock guards it and the verdicts.
+ */
+static pthread_mutex_t licdb_lock = PTHREAD_MUTEX_INITIALIZER;
+static licensedb_t *licdb = NULL;
+static char *licpath = NULL;
+
+/*
+ * Verdicts for License tags already checked against licdb, keyed on
+ * the tag.  Subpackages usually share the License tag of the source
+ * package, so most tags are only evaluated once.  The keys are copies
+ * kept in licarena.
+ */
+static string_map_t *licverdicts = NULL;
+static struct arena *licarena = NULL;
+
+/* Release the database and the verdicts, licdb_lock must be held */
+static void _free_licensedb(void) {
+    close_licensedb(licdb);
+    string_map_free(licverdicts);
+    arena_free(licarena);
+    licdb = NULL;
+    licverdicts = NULL;
+    licarena = NULL;
+    free(licpath);
+    licpath = NULL;
 
-/* Local helper functions */
-static struct json_object *_read_licensedb(const char *licensedb) {
-    int fd = 0;
+    return;
+}
 
-    assert(licensedb != NULL);
+/*
+ * Make sure the license database at licensedb is open.  A database
+ * that is already open is reused, unless it came from a different
+ * file.  licdb_lock must be held.
+ */
+static bool _load_licensedb(const char *licensedb) {
+    if (licdb != NULL && strcmp(licpath, licensedb)) {
+        _free_licensedb();
+    }
+
+    if (licdb == NULL && (licdb = open_licensedb(licensedb)) != NULL) {
+        licpath = strdup(licensedb);
+        assert(licpath != NULL);
+        licverdicts = string_map_new(0);
+        licarena = arena_new();
+    }
+
+    return (licdb != NULL);
+}
+
+/*
+ * License tag expressions.  A tag is parsed in to a tree with this
+ * grammar, where 'and', 'or' and 'with' are matched without regard to
+ * case and bind tighter from left to right:
+ *
+ *     expr   := term ('or' term)*
+ *     term   := factor ('and' factor)*
+ *     factor := '(' expr ')' | phrase
+ *     phrase := word+ ['with' word+]
+ *
+ * A phrase is one or more words because many Fedora abbreviations
+ * contain spaces, e.g. "GPLv2+ with exceptions".
+ */
+enum license_node_type { LICENSE_PHRASE, LICENSE_WITH, LICENSE_AND, LICENSE_OR };
+
+struct license_node {
+    enum license_node_type type;
+    char *phrase;              /* words of a phrase, single spaced */
+    struct license_node *left;
+    struct license_node *right;
+};
+
+/* The tokens of a tag and where the parser is in them */
+struct license_parser {
+    char **tokens;
+    size_t ntokens;
+    size_t pos;
+};
+
+static struct license_node *_parse_expr(struct license_parser *);
+
+static void _free_license_node(struct license_node *node) {
+    if (node == NULL) {
+        return;
+    }
+
+    _free_license_node(node->left);
+    _free_license_node(node->right);
+    free(node->phrase);
+    free(node);
+    return;
+}
+
+static struct license_node *_new_license_node(enum license_node_type type, struct license_node *left, struct license_node *right) {
+    struct license_node *node = NULL;
+
+    node = calloc(1, sizeof(*node));
+    assert(node != NULL);
+    node->type = type;
+    node->left = left;
+    node->right = right;
+
+    return node;
+}
+
+/* Split tag in to words, "(" and ")" */
+static void _tokenize_license(const char *tag, struct license_parser *parser) {
+    const char *p = tag;
+    size_t len;
+
+    parser->tokens = NULL;
+    parser->ntokens = 0;
+    parser->pos = 0;
+
+    while (*p != '\0') {
+        if (isspace((unsigned char) *p)) {
+            p++;
+            continue;
+        }
+
+        len = (*p == '(' || *p == ')') ? 1 : strcspn(p, "() \t\n\r\f\v");
+        parser->tokens = realloc(parser->tokens, (parser->ntokens + 1) * sizeof(*parser->tokens));
+        assert(parser->tokens != NULL);
+        parser->tokens[parser->ntokens] = strndup(p, len);
+        assert(parser->tokens[parser->ntokens] != NULL);
+        parser->ntokens++;
+        p += len;
+    }
 
-    fd = open(licensedb, O_RDONLY);
+    return;
+}
+
+static const char *_peek_token(const struct license_parser *parser) {
+    return (parser->pos < parser->ntokens) ? parser->tokens[parser->pos] : NULL;
+}
+
+static bool _is_keyword(const char *token) {
+    return !strcasecmp(token, "and") || !strcasecmp(token, "or") || !strcasecmp(token, "with");
+}
+
+/* Collect the words of a phrase up to the next keyword or paren */
+static char *_parse_words(struct license_parser *parser) {
+    const char *token = NULL;
+    char *phrase = NULL;
+    char *tmp = NULL;
+
+    while ((token = _peek_token(parser)) != NULL && strcmp(token, "(") && strcmp(token, ")") && !_is_keyword(token)) {
+        if (phrase == NULL) {
+            phrase = strdup(token);
+            assert(phrase != NULL);
+        } else {
+            xasprintf(&tmp, "%s %s", phrase, token);
+            free(phrase);
+            phrase = tmp;
+        }
 
-    if (fd == -1) {
-        fprintf(stderr, "*** Unable to open license db %s: %s\n", licensedb, strerror(errno));
-        fflush(stderr);
+        parser->pos++;
+    }
+
+    return phrase;
+}
+
+static struct license_node *_parse_factor(struct license_parser *parser) {
+    struct license_node *node = NULL;
+    struct license_node *exception = NULL;
+    const char *token = _peek_token(parser);
+    char *words = NULL;
+
+    if (token == NULL) {
         return NULL;
     }
 
-    liclen = lseek(fd, 0, SEEK_END);
-    licdata = mmap(NULL, liclen, PROT_READ, MAP_PRIVATE, fd, 0);
-    close(fd);
+    if (!strcmp(token, "(")) {
+        parser->pos++;
+        node = _parse_expr(parser);
+        token = _peek_token(parser);
+
+        if (node == NULL || token == NULL || strcmp(token, ")")) {
+            _free_license_node(node);
+            return NULL;
+        }
+
+        parser->pos++;
+        return node;
+    }
+
+    if ((words = _parse_words(parser)) == NULL) {
+        return NULL;
+    }
+
+    node = _new_license_node(LICENSE_PHRASE, NULL, NULL);
+    node->phrase = words;
+
+    /* license WITH exception */
+    token = _peek_token(parser);
+
+    if (token != NULL && !strcasecmp(token, "with")) {
+        parser->pos++;
+
+        if ((words = _parse_words(parser)) == NULL) {
+            _free_license_node(node);
+            return NULL;
+        }
+
+        exception = _new_license_node(LICENSE_PHRASE, NULL, NULL);
+        exception->phrase = words;
+        node = _new_license_node(LICENSE_WITH, node, exception);
+        xasprintf(&node->phrase, "%s %s %s", node->left->phrase, token, words);
+    }
+
+    return node;
+}
+
+/* Parse operands separated by keyword in to a left leaning tree */
+static struct license_node *_parse_binary(struct license_parser *parser, const char *keyword, enum license_node_type type,
+                                          struct license_node *(*operand)(struct license_parser *)) {
+    struct license_node *node = NULL;
+    struct license_node *right = NULL;
+    const char *token = NULL;
+
+    if ((node = operand(parser)) == NULL) {
+        return NULL;
+    }
+
+    while ((token = _peek_token(parser)) != NULL && !strcasecmp(token, keyword)) {
+        parser->pos++;
+
+        if ((right = operand(parser)) == NULL) {
+            _free_license_node(node);
+            return NULL;
+        }
+
+        node = _new_license_node(type, node, right);
+    }
+
+    return node;
+}
+
+static struct license_node *_parse_term(struct license_parser *parser) {
+    return _parse_binary(parser, "and", LICENSE_AND, _parse_factor);
+}
 
-    return json_tokener_parse(licdata);
+static struct license_node *_parse_expr(struct license_parser *parser) {
+    return _parse_binary(parser, "or", LICENSE_OR, _parse_term);
+}
+
+/*
+ * Parse a License tag.  Returns NULL if the tag is not a well formed
+ * expression, e.g. if the parentheses do not balance or an operator is
+ * missing an operand.
+ */
+static struct license_node *_parse_license(const char *tag) {
+    struct license_parser parser;
+    struct license_node *node = NULL;
+    size_t i;
+
+    _tokenize_license(tag, &parser);
+    node = _parse_expr(&parser);
+
+    /* everything has to be used up */
+    if (node != NULL && parser.pos != parser.ntokens) {
+        _free_license_node(node);
+        node = NULL;
+    }
+
+    for (i = 0; i < parser.ntokens; i++) {
+        free(parser.tokens[i]);
+    }
+
+    free(parser.tokens);
+    return node;
+}
+
+/*
+ * Is a phrase an approved license?  Either the whole phrase is a known
+ * abbreviation or, as the License tag has always been read, every word
+ * of it is.
+ */
+static bool _is_approved_phrase(const char *phrase) {
+    char *words = NULL;
+    char *walk = NULL;
+    char *word = NULL;
+    bool approved = true;
+
+    if (is_license_abbrev(licdb, phrase)) {
+        return true;
+    }
+
+    if (strchr(phrase, ' ') == NULL) {
+        return false;
+    }
+
+    walk = words = strdup(phrase);
+    assert(words != NULL);
+
+    while (approved && (word = strsep(&walk, " ")) != NULL) {
+        approved = is_license_abbrev(licdb, word);
+    }
+
+    free(words);
+    return approved;
+}
+
+/*
+ * Evaluate a parsed License tag against the license database.  Every
+ * license named has to be approved, whether it is joined by 'and' or
+ * by 'or'.  A license with an exception is approved if the whole
+ * phrase is a known abbreviation, or the license is approved and the
+ * exception is in the database.
+ */
+static bool _eval_license(const struct license_node *node) {
+    switch (node->type) {
+        case LICENSE_PHRASE:
+            return _is_approved_phrase(node->phrase);
+        case LICENSE_WITH:
+            if (is_license_abbrev(licdb, node->phrase)) {
+                return true;
+            }
+
+            return _is_approved_phrase(node->left->phrase)
+                   && (is_license_abbrev(licdb, node->right->phrase)
+                       || is_license_name(licdb, node->right->phrase));
+        case LICENSE_AND:
+        case LICENSE_OR:
+            return _eval_license(node->left) && _eval_license(node->right);
+    }
+
+    return false;
 }
 
 /*
@@ -90,7 +391,7 @@ static int _check_peer_license(struct rpminspect *ri, const Header hdr) {
         }
 
         /* does the license tag contain bad words? */
-        if (has_bad_word(license, ri->badwords)) {
+        if (has_bad_word(license, ri)) {
             xasprintf(&msg, "License Tag contains unprofessional language in %s: %s", nevra, license);
         }
     }
@@ -107,19 +408,9 @@ static int _check_peer_license(struct rpminspect *ri, const Header hdr) {
  * Helper function to clean up the static globals here.
  */
 void free_licensedb(void) {
-    int r;
-
-    if (licdb == NULL) {
-        return;
-    }
-
-    json_object_put(licdb);
-    r = munmap(licdata, liclen);
-    assert(r == 0);
-    licdata = NULL;
-    liclen = 0;
-    licdb = NULL;
-
+    pthread_mutex_lock(&licdb_lock);
+    _free_licensedb();
+    pthread_mutex_unlock(&licdb_lock);
     return;
 }
 
@@ -131,130 +422,49 @@ void free_licensedb(void) {
  * not really make sense for the License tag.  If a license doesn't apply,
  * the RPM cannot ship that.
  *
- * The check involved here consists of multiple parts:
- * 1) Check to see that expressions in parentheses are balance.  For
- *    example, "(GPLv2+ and MIT) or LGPLv2+" is valid, but we want to
- *    make sure that "GPLv2+ and MIT) or (LGPLv2+" is invalid.
- * 2) Tokenize the license tag.
- * 3) Iterate over each token, skipping the 'and' and 'or' keywords, to
- *    match against the license database.
- * 4) The function returns true if all license tags are approved in the
- *    database.  Any single tag that is unapproved results in false.
+ * The tag is parsed in to an expression tree (see _parse_license()).
+ * A tag that does not parse, for example because its parentheses do not
+ * balance as in "GPLv2+ and MIT) or (LGPLv2+", is invalid.  Otherwise
+ * the tag is approved if every license it names is approved in the
+ * database.  A tag that is the full name of a license in the database
+ * is valid as it is.
+ *
+ * The verdict for each distinct tag is remembered until the license
+ * database is freed.
  */
 bool is_valid_license(const char *licensedb, const char *tag) {
-    int seen = 0;
-    int valid = 0;
-    int balance = 0;
-    size_t i = 0;
-    char *tagtokens = NULL;
-    char *tagcopy = NULL;
-    char *lic = NULL;
-    const char *fedora_abbrev = NULL;
-    const char *spdx_abbrev = NULL;
-    bool approved = false;
-    bool wholetag = false;
+    struct license_node *expr = NULL;
+    void *verdict = NULL;
+    bool valid = false;
 
     assert(licensedb != NULL);
     assert(tag != NULL);
 
-    /* check for matching parens */
-    for (i = 0; i < strlen(tag); i++) {
-        if (balance < 0) {
-            return false;
-        }
+    pthread_mutex_lock(&licdb_lock);
 
-        if (tag[i] == '(') {
-            balance++;
-            continue;
-        }
-
-        if (tag[i] == ')') {
-            balance--;
-        }
-    }
-
-    if (balance != 0) {
+    /* read in the approved license database */
+    if (!_load_licensedb(licensedb)) {
+        pthread_mutex_unlock(&licdb_lock);
         return false;
     }
 
-    /* read in the approved license database */
-    if (licdb == NULL) {
-        licdb = _read_licensedb(licensedb);
-
-        if (licdb == NULL) {
-            return false;
-        }
+    if (string_map_get(licverdicts, tag, &verdict)) {
+        pthread_mutex_unlock(&licdb_lock);
+        return verdict != NULL;
     }
 
-    /* tokenize the license tag and validate each license */
-    tagtokens = tagcopy = strdup(tag);
-
-    while ((lic = strsep(&tagtokens, "() ")) != NULL) {
-        /* skip over empty strings and the boolean keywords */
-        if (strlen(lic) == 0 || !strcasecmp(lic, "and") || !strcasecmp(lic, "or")) {
-            continue;
-        }
-
-        wholetag = false;
-        seen++;
-
-        /* iterate over the license database to match this license tag */
-        json_object_object_foreach(licdb, license_name, val) {
-            /* first reset our variables */
-            fedora_abbrev = NULL;
-            spdx_abbrev = NULL;
-            approved = false;
-
-            /* if the entire license string matches the name, approved */
-            if (!strcmp(tag, license_name)) {
-                wholetag = true;
-                break;
-            }
-
-            /* collect the properties */
-            json_object_object_foreach(val, prop, propval) {
-                if (!strcmp(prop, "fedora_abbrev")) {
-                    fedora_abbrev = json_object_get_string(propval);
-                } else if (!strcmp(prop, "spdx_abbrev")) {
-                    spdx_abbrev = json_object_get_string(propval);
-                } else if (!strcmp(prop, "approved")) {
-                    approved = json_object_get_boolean(propval);
-                }
-            }
-
-            /*
-             * if either of these are empty, it means the entire license
-             * name is the only thing we can match and if we got here it
-             * means we didn't match it, so continue.
-             */
-            if (strlen(fedora_abbrev) == 0 && strlen(spdx_abbrev) == 0) {
-                continue;
-            }
-
-            /*
-             * if we hit 'fedora_abbrev', that is valid
-             * if we hit 'spdx_abbrev' and approved is true, that is valid
-             * NOTE: we only match the first hit in the license database
-             */
-            if (!strcmp(lic, fedora_abbrev) || (!strcmp(lic, spdx_abbrev) && approved)) {
-                valid++;
-                break;
-            }
-        }
-
-        if (wholetag) {
-            break;
-        }
+    /* if the entire license string matches a license name, approved */
+    if (is_license_name(licdb, tag)) {
+        valid = true;
+    } else if ((expr = _parse_license(tag)) != NULL) {
+        valid = _eval_license(expr);
+        _free_license_node(expr);
     }
 
-    /* cleanup */
-    free(tagcopy);
+    string_map_add(licverdicts, arena_strdup(licarena, tag), valid ? (void *) licverdicts : NULL);
+    pthread_mutex_unlock(&licdb_lock);
 
-    /*
-     * license tag is approved if number of seen tags equals
-     * number of valid tags
-     */
-    return (seen == valid);
+    return valid;
 }
 
 /*
@@ -284,8 +494,6 @@ bool inspect_license(struct rpminspect *ri) {
         seen++;
     }
 
-    /* Clean up */
-    free_licensedb();
-
+    /* the license database stays loaded for the next run */
     return (good == seen);
 }
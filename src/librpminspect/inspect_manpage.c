@@ -20,6 +20,7 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <pthread.h>
 #include <regex.h>
 #include <stdarg.h>
 #include <stddef.h>
@@ -40,6 +41,13 @@
 
 static regex_t sections_regex;
 
+/*
+ * libmandoc keeps process wide state (the mchars table among others)
+ * and does not say it is thread safe, so only one man page is parsed
+ * at a time even when the payload walk runs on several threads.
+ */
+static pthread_mutex_t mandoc_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /* Allocate memory used by inspect_manpage */
 bool inspect_manpage_alloc(void)
 {
@@ -152,7 +160,8 @@ char * inspect_manpage_validity(const char *path)
     error_stream = open_memstream(&error_buffer, &error_buffer_size);
     assert(error_stream != NULL);
 
-    /* Allocate a new manpage parsing context */
+    /* Allocate a new manpage parsing context, held until mparse_free() */
+    pthread_mutex_lock(&mandoc_lock);
     parser = mparse_alloc(MPARSE_MAN | MPARSE_SO | MPARSE_UTF8 | MPARSE_LATIN1,
             MANDOCERR_ERROR, error_handler, MANDOC_OS_OTHER, NULL);
     assert(parser != NULL);
@@ -204,6 +213,7 @@ char * inspect_manpage_validity(const char *path)
 
 end:
     mparse_free(parser);
+    pthread_mutex_unlock(&mandoc_lock);
 
     if (fd != -1) {
         close(fd);
@@ -220,29 +230,14 @@ end:
     return error_buffer;
 }
 
-static bool _manpage_driver(struct rpminspect *ri, rpmfile_entry_t *file)
+/* Run the man page checks on a payload file that passed the path filters */
+static bool _manpage_file_driver(struct rpminspect *ri, rpmfile_entry_t *file, const char *localpath)
 {
     char *manpage_errors;
-    const char *localpath;
     bool result = true;
     const char *arch;
     char *msg = NULL;
 
-    /* Is this a man page? */
-    if (!file->fullpath || !S_ISREG(file->st.st_mode)) {
-        return true;
-    }
-
-    if (!process_file_path(file, ri->manpage_path_include, ri->manpage_path_exclude)) {
-        return true;
-    }
-
-    localpath = get_file_path(file);
-
-    if (!localpath) {
-        return true;
-    }
-
     arch = headerGetString(file->rpm_header, RPMTAG_ARCH);
 
     if ((manpage_errors = inspect_manpage_validity(file->fullpath)) != NULL) {
@@ -266,6 +261,39 @@ static bool _manpage_driver(struct rpminspect *ri, rpmfile_entry_t *file)
     return result;
 }
 
+static bool _manpage_driver(struct rpminspect *ri, rpmfile_entry_t *file)
+{
+    const char *localpath;
+
+    /* Is this a man page? */
+    if (!file->fullpath || !S_ISREG(file->st.st_mode)) {
+        return true;
+    }
+
+    if (!process_file_path(file, ri->manpage_path_include, ri->manpage_path_exclude)) {
+        return true;
+    }
+
+    localpath = get_file_path(file);
+
+    if (!localpath) {
+        return true;
+    }
+
+    return _manpage_file_driver(ri, file, localpath);
+}
+
+const struct inspect_files manpage_files = {
+    FILE_KIND_REGULAR,
+    HEADER_MAN,
+    offsetof(struct rpminspect, manpage_path_include),
+    offsetof(struct rpminspect, manpage_path_exclude),
+    true,
+    inspect_manpage_alloc,
+    inspect_manpage_free,
+    _manpage_file_driver
+};
+
 bool inspect_manpage(struct rpminspect *ri)
 {
     bool result;
@@ -64,7 +64,7 @@ static bool _valid_peers(struct rpminspect *ri,
     }
 
     after_summary = headerGetAsString(after_hdr, RPMTAG_SUMMARY);
-    if (after_summary && has_bad_word(after_summary, ri->badwords)) {
+    if (after_summary && has_bad_word(after_summary, ri)) {
         xasprintf(&msg, "Package Summary contains unprofessional language in %s", after_nevra);
         xasprintf(&dump, "Summary: %s", after_summary);
 
@@ -76,7 +76,7 @@ static bool _valid_peers(struct rpminspect *ri,
     }
 
     after_description = headerGetAsString(after_hdr, RPMTAG_DESCRIPTION);
-    if (after_description && has_bad_word(after_description, ri->badwords)) {
+    if (after_description && has_bad_word(after_description, ri)) {
         xasprintf(&msg, "Package Description contains unprofessional language in %s:", after_nevra);
 
         add_result(&ri->results, RESULT_BAD, NOT_WAIVABLE, HEADER_METADATA, msg, after_description, REMEDY_BADWORDS);
@@ -19,7 +19,10 @@
 #include "config.h"
 
 #include <assert.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <string.h>
 #include <sys/stat.h>
 
@@ -32,26 +35,22 @@
 #include "inspect.h"
 #include "rpminspect.h"
 
+static pthread_once_t xml_initialized = PTHREAD_ONCE_INIT;
+
+/* libxml2 must be initialized once before parsing from multiple threads */
+static void _init_xml(void)
+{
+    LIBXML_TEST_VERSION
+}
+
 /*
- * Return true if the given file is a well-formed XML document, false otherwise.
- * This only checks if the XML is well-formed. No validation is performed.
+ * Report whether the parser finished with a well-formed document and
+ * free the parser state.
  */
-bool is_xml_well_formed(const char *path, char **errors)
+static bool _xml_parse_result(xmlParserCtxtPtr ctxt, xmlDocPtr doc, char **errors)
 {
-    static bool initialized = false;
-    xmlParserCtxtPtr ctxt;
-    xmlDocPtr doc;
     bool result;
 
-    if (!initialized) {
-        LIBXML_TEST_VERSION
-        initialized = true;
-    }
-
-    ctxt = xmlNewParserCtxt();
-    assert(ctxt != NULL);
-    doc = xmlCtxtReadFile(ctxt, path, NULL, XML_PARSE_PEDANTIC);
-
     if (!ctxt->valid) {
         if (errors != NULL) {
             *errors = strdup(ctxt->lastError.message);
@@ -68,38 +67,67 @@ bool is_xml_well_formed(const char *path, char **errors)
 
     xmlFreeParserCtxt(ctxt);
 
-    return result;;
+    return result;
 }
 
-static bool is_xml(const char *path)
+/*
+ * Return true if the given file is a well-formed XML document, false otherwise.
+ * This only checks if the XML is well-formed. No validation is performed.
+ */
+bool is_xml_well_formed(const char *path, char **errors)
 {
-    FILE *input;
-    unsigned char buffer[32];
-    unsigned char *xml_data;
-    size_t bytes_read;
+    xmlParserCtxtPtr ctxt;
+    xmlDocPtr doc;
 
-    const char xml_ascii_prelude[] = "<?xml version=";
-    const char xml_utf16_le_prelude[] = "<\0?\0x\0m\0l\0 \0v\0e\0r\0s\0i\0o\0n\0=\0";
-    const char xml_utf16_be_prelude[] = "\0<\0?\0x\0m\0l\0 \0v\0e\0r\0s\0i\0o\0n\0=";
-    const char *xml_prelude;
-    size_t min_size;
+    pthread_once(&xml_initialized, _init_xml);
 
-    input = fopen(path, "r");
+    ctxt = xmlNewParserCtxt();
+    assert(ctxt != NULL);
+    doc = xmlCtxtReadFile(ctxt, path, NULL, XML_PARSE_PEDANTIC);
 
-    if (input == NULL) {
-        return false;
-    }
+    return _xml_parse_result(ctxt, doc, errors);
+}
 
-    /* Look for an optional byte-order marker, followed by "<?xml version=" */
-    bytes_read = fread(buffer, 1, sizeof(buffer), input);
+/*
+ * Like is_xml_well_formed(), but for a document already in memory.
+ * url is only used to resolve relative references and may be NULL.
+ * libxml2 takes the size as an int, so larger documents are rejected.
+ */
+bool is_xml_well_formed_memory(const char *buffer, size_t size, const char *url, char **errors)
+{
+    xmlParserCtxtPtr ctxt;
+    xmlDocPtr doc;
+
+    if (size > INT_MAX) {
+        if (errors != NULL) {
+            xasprintf(errors, "Document is %zu bytes, too large to parse from memory", size);
+        }
 
-    if (ferror(input)) {
-        fclose(input);
         return false;
     }
 
-    fclose(input);
-    xml_data = buffer;
+    pthread_once(&xml_initialized, _init_xml);
+
+    ctxt = xmlNewParserCtxt();
+    assert(ctxt != NULL);
+    doc = xmlCtxtReadMemory(ctxt, buffer, (int) size, url, NULL, XML_PARSE_PEDANTIC);
+
+    return _xml_parse_result(ctxt, doc, errors);
+}
+
+/*
+ * Return true if the first bytes of a file look like the start of an
+ * XML document: an optional byte-order marker followed by "<?xml version=".
+ */
+bool is_xml_prelude(const unsigned char *buffer, size_t bytes_read)
+{
+    const unsigned char *xml_data = buffer;
+
+    const char xml_ascii_prelude[] = "<?xml version=";
+    const char xml_utf16_le_prelude[] = "<\0?\0x\0m\0l\0 \0v\0e\0r\0s\0i\0o\0n\0=\0";
+    const char xml_utf16_be_prelude[] = "\0<\0?\0x\0m\0l\0 \0v\0e\0r\0s\0i\0o\0n\0=";
+    const char *xml_prelude;
+    size_t min_size;
 
     /* Look for a byte-order marker */
     /* The XML spec says everyone has to deal with at least utf-8 and utf-16, so handle those */
@@ -130,12 +158,60 @@ static bool is_xml(const char *path)
     return (bytes_read >= min_size) && (memcmp(xml_data, xml_prelude, min_size) == 0);
 }
 
-static bool _xml_driver(struct rpminspect *ri, rpmfile_entry_t *file)
+static bool is_xml(const char *path)
+{
+    FILE *input;
+    unsigned char buffer[32];
+    size_t bytes_read;
+
+    input = fopen(path, "r");
+
+    if (input == NULL) {
+        return false;
+    }
+
+    /* Look for an optional byte-order marker, followed by "<?xml version=" */
+    bytes_read = fread(buffer, 1, sizeof(buffer), input);
+
+    if (ferror(input)) {
+        fclose(input);
+        return false;
+    }
+
+    fclose(input);
+
+    return is_xml_prelude(buffer, bytes_read);
+}
+
+/* Check an XML payload file that passed the path filters */
+static bool _xml_file_driver(struct rpminspect *ri, rpmfile_entry_t *file, const char *localpath)
 {
     char *errors = NULL;
     char *msg = NULL;
     bool result;
 
+    if (file->contents != NULL) {
+        result = is_xml_well_formed_memory(file->contents, file->contents_size, localpath, &errors);
+    } else {
+        result = is_xml_well_formed(file->fullpath, &errors);
+    }
+
+    if (!result) {
+        xasprintf(&msg, "File %s has become malformed XML on %s", localpath, headerGetString(file->rpm_header, RPMTAG_ARCH));
+
+        add_result(&ri->results, RESULT_VERIFY, WAIVABLE_BY_ANYONE, HEADER_XML, msg, errors, REMEDY_XML);
+
+        free(msg);
+    }
+
+    free(errors);
+    return result;
+}
+
+static bool _xml_driver(struct rpminspect *ri, rpmfile_entry_t *file)
+{
+    const char *localpath;
+
     /* Is this an XML file? */
     if (!file->fullpath || !S_ISREG(file->st.st_mode)) {
         return true;
@@ -149,20 +225,26 @@ static bool _xml_driver(struct rpminspect *ri, rpmfile_entry_t *file)
         return true;
     }
 
-    result = is_xml_well_formed(file->fullpath, &errors);
-
-    if (!result) {
-        xasprintf(&msg, "File %s has become malformed XML on %s", get_file_path(file), headerGetString(file->rpm_header, RPMTAG_ARCH));
-
-        add_result(&ri->results, RESULT_VERIFY, WAIVABLE_BY_ANYONE, HEADER_XML, msg, errors, REMEDY_XML);
+    localpath = get_file_path(file);
 
-        free(msg);
+    if (!localpath) {
+        return true;
     }
 
-    free(errors);
-    return result;
+    return _xml_file_driver(ri, file, localpath);
 }
 
+const struct inspect_files xml_files = {
+    FILE_KIND_XML,
+    HEADER_XML,
+    offsetof(struct rpminspect, xml_path_include),
+    offsetof(struct rpminspect, xml_path_exclude),
+    false,
+    NULL,
+    NULL,
+    _xml_file_driver
+};
+
 bool inspect_xml(struct rpminspect *ri)
 {
     return foreach_peer_file(ri, _xml_driver);
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2019  Red Hat, Inc.
+ * Author(s):  David Cantrell <dcantrell@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rpminspect.h"
+
+/*
+ * State shared by all of the workers in a run_jobs() call.  Workers
+ * claim items by bumping 'next', so a worker that finishes its item
+ * early simply takes the next unclaimed one.
+ */
+struct jobqueue {
+    size_t next;
+    size_t njobs;
+    job_func func;
+    void *data;
+};
+
+struct jobworker {
+    struct jobqueue *queue;
+    unsigned int id;
+    pthread_t thread;
+    bool started;
+};
+
+static void *_job_worker(void *arg) {
+    struct jobworker *worker = arg;
+    struct jobqueue *queue = worker->queue;
+    size_t item;
+
+    while ((item = __atomic_fetch_add(&queue->next, 1, __ATOMIC_RELAXED)) < queue->njobs) {
+        queue->func(queue->data, worker->id, item);
+    }
+
+    return NULL;
+}
+
+/*
+ * Call func for every item in [0, njobs) using up to nthreads threads.
+ * The calling thread is always worker 0 and takes part in the work, so
+ * nthreads of 0 or 1 runs everything serially in item order.  The
+ * worker number passed to func is below nthreads and can be used to
+ * index per-worker state.  Returns once every item has been processed.
+ */
+void run_jobs(unsigned int nthreads, size_t njobs, job_func func, void *data) {
+    struct jobqueue queue;
+    struct jobworker *workers = NULL;
+    unsigned int i;
+    int r;
+
+    assert(func != NULL);
+
+    if (njobs == 0) {
+        return;
+    }
+
+    if (nthreads > njobs) {
+        nthreads = njobs;
+    }
+
+    queue.next = 0;
+    queue.njobs = njobs;
+    queue.func = func;
+    queue.data = data;
+
+    if (nthreads <= 1) {
+        for (queue.next = 0; queue.next < njobs; queue.next++) {
+            func(data, 0, queue.next);
+        }
+
+        return;
+    }
+
+    workers = calloc(nthreads, sizeof(*workers));
+    assert(workers != NULL);
+
+    for (i = 0; i < nthreads; i++) {
+        workers[i].queue = &queue;
+        workers[i].id = i;
+    }
+
+    /* if a thread cannot be started, the remaining workers pick up the slack */
+    for (i = 1; i < nthreads; i++) {
+        if ((r = pthread_create(&workers[i].thread, NULL, _job_worker, &workers[i])) != 0) {
+            fprintf(stderr, "*** Unable to start worker thread: %s\n", strerror(r));
+            fflush(stderr);
+            break;
+        }
+
+        workers[i].started = true;
+    }
+
+    _job_worker(&workers[0]);
+
+    for (i = 1; i < nthreads; i++) {
+        if (workers[i].started) {
+            r = pthread_join(workers[i].thread, NULL);
+            assert(r == 0);
+        }
+    }
+
+    free(workers);
+    return;
+}
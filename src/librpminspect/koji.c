@@ -69,6 +69,8 @@ void free_koji_rpmlist(koji_rpmlist_t *rpms) {
         entry->version = NULL;
         free(entry->release);
         entry->release = NULL;
+        free(entry->payloadhash);
+        entry->payloadhash = NULL;
         free(entry);
     }
 
@@ -146,6 +148,8 @@ void free_koji_build(struct koji_build *build) {
 
 /*
  * Look up a Koji build and return the information in a struct koji_build.
+ * Completed builds are answered from the Koji response cache when
+ * possible, so repeat runs do not need to talk to the hub at all.
  */
 struct koji_build *get_koji_build(struct rpminspect *ri, const char *buildspec) {
     struct koji_build *build = NULL;
@@ -173,6 +177,11 @@ struct koji_build *get_koji_build(struct rpminspect *ri, const char *buildspec)
         return NULL;
     }
 
+    /* a completed build never changes, so a cached answer is good */
+    if ((build = get_cached_koji_build(ri, buildspec)) != NULL) {
+        return build;
+    }
+
     /* initialize everything and get XMLRPC ready */
     build = calloc(1, sizeof(*build));
     assert(build != NULL);
@@ -342,12 +351,16 @@ struct koji_build *get_koji_build(struct rpminspect *ri, const char *buildspec)
                 xmlrpc_parse_value(&env, value, "s", &s);
                 xmlrpc_abort_on_fault(&env);
                 rpm->release = strdup(s);
+            } else if (!strcmp(key, "payloadhash") && (xmlrpc_value_type(value) == XMLRPC_TYPE_STRING)) {
+                xmlrpc_parse_value(&env, value, "s", &s);
+                xmlrpc_abort_on_fault(&env);
+                rpm->payloadhash = strdup(s);
             }
 
             xmlrpc_DECREF(k);
             xmlrpc_DECREF(value);
 
-            if (rpm->arch != NULL && rpm->name != NULL && rpm->version != NULL && rpm->release != NULL) {
+            if (rpm->arch != NULL && rpm->name != NULL && rpm->version != NULL && rpm->release != NULL && rpm->payloadhash != NULL) {
                 break;
             }
         }
@@ -362,5 +375,7 @@ struct koji_build *get_koji_build(struct rpminspect *ri, const char *buildspec)
     xmlrpc_env_clean(&env);
     xmlrpc_client_cleanup();
 
+    add_cached_koji_build(ri, buildspec, build);
+
     return build;
 }
@@ -0,0 +1,723 @@
+/*
+ * Copyright (C) 2019  Red Hat, Inc.
+ * Author(s):  David Cantrell <dcantrell@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The license database.  The 'license' inspection only needs to know
+ * two things about it: is a string the full name of a license, and is
+ * it an abbreviation that may be used in a License tag (any
+ * fedora_abbrev, or the spdx_abbrev of an approved license).
+ *
+ * The database is maintained as JSON.  compile_licensedb() turns the
+ * JSON in to a binary file holding just those two sets of strings,
+ * which open_licensedb() maps and uses as is, with no parsing.  The
+ * binary file for "name.json" is "name.ldb" and it is used when it is
+ * at least as new as the JSON.  Otherwise the JSON is read and indexed.
+ * Nothing builds the binary file during installation, using it is
+ * opt-in: run mklicensedb on the JSON file to create it.
+ *
+ * Binary layout, all integers are uint32_t in host byte order.  A
+ * compiled database only works on hosts with the byte order of the
+ * host that compiled it, so it must not be shipped in a noarch
+ * package.  A database of the other byte order is ignored with a
+ * warning and the JSON is used instead.
+ *
+ *     struct ldb_header
+ *     string table: every string once, NUL terminated
+ *     for each of the two sets:
+ *         strings[count]   string table offsets, in strcmp() order
+ *         seeds[nbuckets]  perfect hash seed of each bucket
+ *         slots[count]     index in to strings[] of each hash slot
+ *
+ * A string is looked up by hashing it with seed 0 to pick a bucket,
+ * then with the seed of that bucket to pick its slot, and comparing
+ * the one string in that slot.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <json.h>
+
+#include "rpminspect.h"
+
+#define LDB_MAGIC         "RPMILDB"
+#define LDB_VERSION       1
+#define LDB_BUCKET_SIZE   4
+#define LDB_MAX_SEED      (1U << 24)
+
+enum { LDB_NAMES, LDB_ABBREVS, LDB_NSETS };
+
+struct ldb_set {
+    uint32_t count;
+    uint32_t nbuckets;
+    uint32_t strings;          /* file offset of strings[] */
+    uint32_t seeds;            /* file offset of seeds[] */
+    uint32_t slots;            /* file offset of slots[] */
+};
+
+struct ldb_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t size;             /* of the whole file */
+    uint32_t checksum;         /* FNV-1a of everything after the header */
+    uint32_t strtab;           /* file offset of the string table */
+    uint32_t strtab_size;
+    struct ldb_set sets[LDB_NSETS];
+};
+
+struct licensedb {
+    /* a compiled database, mapped */
+    const unsigned char *map;
+    size_t maplen;
+
+    /* or the JSON database and an index of it */
+    struct json_object *json;
+    string_map_t *sets[LDB_NSETS];
+};
+
+static uint32_t _checksum(const unsigned char *data, size_t len) {
+    uint32_t hash = 2166136261U;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        hash = (hash ^ data[i]) * 16777619U;
+    }
+
+    return hash;
+}
+
+static uint32_t _ldb_hash(const char *key, uint32_t seed) {
+    uint64_t hash = 14695981039346656037ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+    const unsigned char *c = NULL;
+
+    for (c = (const unsigned char *) key; *c != '\0'; c++) {
+        hash = (hash ^ *c) * 1099511628211ULL;
+    }
+
+    return (uint32_t) (hash ^ (hash >> 32));
+}
+
+/*
+ * Hand every full license name and every usable abbreviation in the
+ * JSON database to add().
+ */
+static void _walk_json(struct json_object *json, void (*add)(int, const char *, void *), void *data) {
+    const char *fedora_abbrev = NULL;
+    const char *spdx_abbrev = NULL;
+    bool approved = false;
+
+    json_object_object_foreach(json, license_name, val) {
+        fedora_abbrev = NULL;
+        spdx_abbrev = NULL;
+        approved = false;
+
+        add(LDB_NAMES, license_name, data);
+
+        /* collect the properties */
+        json_object_object_foreach(val, prop, propval) {
+            if (!strcmp(prop, "fedora_abbrev")) {
+                fedora_abbrev = json_object_get_string(propval);
+            } else if (!strcmp(prop, "spdx_abbrev")) {
+                spdx_abbrev = json_object_get_string(propval);
+            } else if (!strcmp(prop, "approved")) {
+                approved = json_object_get_boolean(propval);
+            }
+        }
+
+        /*
+         * a 'fedora_abbrev' is valid, a 'spdx_abbrev' is valid if the
+         * license is approved.  Empty ones mean only the full name can
+         * match.
+         */
+        if (fedora_abbrev != NULL && *fedora_abbrev != '\0') {
+            add(LDB_ABBREVS, fedora_abbrev, data);
+        }
+
+        if (approved && spdx_abbrev != NULL && *spdx_abbrev != '\0') {
+            add(LDB_ABBREVS, spdx_abbrev, data);
+        }
+    }
+
+    return;
+}
+
+static struct json_object *_read_json(const char *path) {
+    struct json_object *json = NULL;
+    struct json_tokener *tok = NULL;
+    char *data = NULL;
+    off_t len;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) == -1) {
+        fprintf(stderr, "*** Unable to open license db %s: %s\n", path, strerror(errno));
+        fflush(stderr);
+        return NULL;
+    }
+
+    len = lseek(fd, 0, SEEK_END);
+    data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "*** Unable to read license db %s: %s\n", path, strerror(errno));
+        fflush(stderr);
+        return NULL;
+    }
+
+    /* the mapping is not NUL terminated, so give the parser its length */
+    tok = json_tokener_new();
+    assert(tok != NULL);
+    json = json_tokener_parse_ex(tok, data, len);
+    json_tokener_free(tok);
+    munmap(data, len);
+
+    if (json == NULL) {
+        fprintf(stderr, "*** Unable to parse license db %s\n", path);
+        fflush(stderr);
+    }
+
+    return json;
+}
+
+static void _add_to_map(int set, const char *s, void *data) {
+    struct licensedb *db = data;
+
+    string_map_add(db->sets[set], s, NULL);
+    return;
+}
+
+/*
+ * Map the compiled database at path, false if it is not a valid one.
+ * Complain about an invalid file only if warn is set.
+ */
+static bool _map_compiled(struct licensedb *db, const char *path, bool warn) {
+    const struct ldb_header *hdr = NULL;
+    const struct ldb_set *set = NULL;
+    struct stat sb;
+    void *map = NULL;
+    int fd;
+    int i;
+
+    if ((fd = open(path, O_RDONLY)) == -1) {
+        return false;
+    }
+
+    if (fstat(fd, &sb) == -1 || (size_t) sb.st_size < sizeof(*hdr)) {
+        close(fd);
+        return false;
+    }
+
+    map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    /* check the header and that every table is inside the file */
+    hdr = map;
+
+    if (!memcmp(hdr->magic, LDB_MAGIC, sizeof(LDB_MAGIC)) && hdr->version == __builtin_bswap32(LDB_VERSION)) {
+        if (warn) {
+            fprintf(stderr, "*** Ignoring compiled license db %s, it was built on a host of the other byte order\n", path);
+            fflush(stderr);
+        }
+
+        munmap(map, sb.st_size);
+        return false;
+    }
+
+    if (memcmp(hdr->magic, LDB_MAGIC, sizeof(LDB_MAGIC)) || hdr->version != LDB_VERSION
+        || hdr->size != (uint64_t) sb.st_size
+        || hdr->checksum != _checksum((const unsigned char *) map + sizeof(*hdr), hdr->size - sizeof(*hdr))
+        || (uint64_t) hdr->strtab + hdr->strtab_size > hdr->size || hdr->strtab_size == 0
+        || ((const char *) map)[hdr->strtab + hdr->strtab_size - 1] != '\0') {
+        goto bad;
+    }
+
+    for (i = 0; i < LDB_NSETS; i++) {
+        set = &hdr->sets[i];
+
+        if (set->nbuckets == 0
+            || (uint64_t) set->strings + set->count * sizeof(uint32_t) > hdr->size
+            || (uint64_t) set->seeds + set->nbuckets * sizeof(uint32_t) > hdr->size
+            || (uint64_t) set->slots + set->count * sizeof(uint32_t) > hdr->size
+            || set->strings % sizeof(uint32_t) || set->seeds % sizeof(uint32_t) || set->slots % sizeof(uint32_t)) {
+            goto bad;
+        }
+    }
+
+    db->map = map;
+    db->maplen = sb.st_size;
+    return true;
+
+bad:
+    if (warn) {
+        fprintf(stderr, "*** Ignoring invalid compiled license db %s\n", path);
+        fflush(stderr);
+    }
+
+    munmap(map, sb.st_size);
+    return false;
+}
+
+/* Name of the compiled database for a JSON one, or NULL */
+static char *_compiled_path(const char *path) {
+    char *compiled = NULL;
+
+    if (!strsuffix(path, ".json")) {
+        return NULL;
+    }
+
+    xasprintf(&compiled, "%.*s.ldb", (int) strlen(path) - 5, path);
+    return compiled;
+}
+
+/*
+ * Open the license database at path.  path may be a compiled database
+ * or a JSON one, in which case the compiled database next to it is
+ * used if it is up to date.  A path ending in ".json" is always JSON.
+ * Returns NULL on error.
+ */
+licensedb_t *open_licensedb(const char *path) {
+    struct licensedb *db = NULL;
+    struct stat jsb;
+    struct stat csb;
+    char *compiled = NULL;
+    int i;
+
+    assert(path != NULL);
+
+    db = calloc(1, sizeof(*db));
+    assert(db != NULL);
+
+    if ((compiled = _compiled_path(path)) == NULL) {
+        if (_map_compiled(db, path, strsuffix(path, ".ldb"))) {
+            return db;
+        }
+    } else if (stat(compiled, &csb) == 0 && stat(path, &jsb) == 0
+               && csb.st_mtime >= jsb.st_mtime && _map_compiled(db, compiled, true)) {
+        free(compiled);
+        return db;
+    }
+
+    free(compiled);
+
+    if ((db->json = _read_json(path)) == NULL) {
+        free(db);
+        return NULL;
+    }
+
+    for (i = 0; i < LDB_NSETS; i++) {
+        db->sets[i] = string_map_new(json_object_object_length(db->json));
+    }
+
+    _walk_json(db->json, _add_to_map, db);
+    return db;
+}
+
+static bool _ldb_contains(const struct licensedb *db, int which, const char *s) {
+    const struct ldb_header *hdr = NULL;
+    const struct ldb_set *set = NULL;
+    const uint32_t *strings = NULL;
+    const uint32_t *seeds = NULL;
+    const uint32_t *slots = NULL;
+    uint32_t slot;
+    uint32_t idx;
+
+    if (db->map == NULL) {
+        return string_map_get(db->sets[which], s, NULL);
+    }
+
+    hdr = (const struct ldb_header *) db->map;
+    set = &hdr->sets[which];
+
+    if (set->count == 0) {
+        return false;
+    }
+
+    strings = (const uint32_t *) (db->map + set->strings);
+    seeds = (const uint32_t *) (db->map + set->seeds);
+    slots = (const uint32_t *) (db->map + set->slots);
+
+    slot = _ldb_hash(s, seeds[_ldb_hash(s, 0) % set->nbuckets]) % set->count;
+    idx = slots[slot];
+
+    if (idx >= set->count || strings[idx] >= hdr->strtab_size) {
+        return false;
+    }
+
+    return !strcmp((const char *) db->map + hdr->strtab + strings[idx], s);
+}
+
+/* Is s the full name of a license in the database? */
+bool is_license_name(const licensedb_t *db, const char *s) {
+    assert(db != NULL);
+    assert(s != NULL);
+    return _ldb_contains(db, LDB_NAMES, s);
+}
+
+/* Is s an abbreviation that may be used in a License tag? */
+bool is_license_abbrev(const licensedb_t *db, const char *s) {
+    assert(db != NULL);
+    assert(s != NULL);
+    return _ldb_contains(db, LDB_ABBREVS, s);
+}
+
+void close_licensedb(licensedb_t *db) {
+    int i;
+
+    if (db == NULL) {
+        return;
+    }
+
+    if (db->map != NULL) {
+        munmap((void *) db->map, db->maplen);
+    }
+
+    for (i = 0; i < LDB_NSETS; i++) {
+        string_map_free(db->sets[i]);
+    }
+
+    if (db->json != NULL) {
+        json_object_put(db->json);
+    }
+
+    free(db);
+    return;
+}
+
+/*
+ * Building a compiled database.  Strings are collected per set, sorted
+ * and made unique, then laid out and hashed.
+ */
+struct ldb_builder {
+    const char **strings[LDB_NSETS];
+    size_t count[LDB_NSETS];
+};
+
+static void _add_to_builder(int set, const char *s, void *data) {
+    struct ldb_builder *b = data;
+
+    b->strings[set] = realloc(b->strings[set], (b->count[set] + 1) * sizeof(*b->strings[set]));
+    assert(b->strings[set] != NULL);
+    b->strings[set][b->count[set]++] = s;
+    return;
+}
+
+static int _compare_strings(const void *a, const void *b) {
+    return strcmp(*(const char * const *) a, *(const char * const *) b);
+}
+
+/* Sort and drop duplicates */
+static size_t _unique_strings(const char **strings, size_t count) {
+    size_t i;
+    size_t n = 0;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    qsort(strings, count, sizeof(*strings), _compare_strings);
+
+    for (i = 1, n = 1; i < count; i++) {
+        if (strcmp(strings[i], strings[n - 1])) {
+            strings[n++] = strings[i];
+        }
+    }
+
+    return n;
+}
+
+static int _compare_buckets(const void *a, const void *b, void *data) {
+    const uint32_t *sizes = data;
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+
+    /* biggest first, then by number so the result is reproducible */
+    if (sizes[x] != sizes[y]) {
+        return (sizes[x] < sizes[y]) ? 1 : -1;
+    }
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * Find a seed for every bucket so the strings map to distinct slots.
+ * Large buckets are placed first while most slots are free.  Returns
+ * false if some bucket could not be placed.
+ */
+static bool _build_perfect_hash(const char **strings, uint32_t count, uint32_t nbuckets, uint32_t *seeds, uint32_t *slots) {
+    uint32_t *bucket_of = NULL;
+    uint32_t *sizes = NULL;
+    uint32_t *order = NULL;
+    uint32_t *members = NULL;
+    uint32_t *tried = NULL;
+    bool *taken = NULL;
+    uint32_t nmembers;
+    uint32_t b;
+    uint32_t i;
+    uint32_t j;
+    uint32_t k;
+    uint32_t seed;
+    bool ok = true;
+
+    bucket_of = calloc(count, sizeof(*bucket_of));
+    sizes = calloc(nbuckets, sizeof(*sizes));
+    order = calloc(nbuckets, sizeof(*order));
+    members = calloc(count, sizeof(*members));
+    tried = calloc(count, sizeof(*tried));
+    taken = calloc(count, sizeof(*taken));
+    assert(bucket_of != NULL && sizes != NULL && order != NULL);
+    assert(members != NULL && tried != NULL && taken != NULL);
+
+    for (i = 0; i < count; i++) {
+        bucket_of[i] = _ldb_hash(strings[i], 0) % nbuckets;
+        sizes[bucket_of[i]]++;
+    }
+
+    for (b = 0; b < nbuckets; b++) {
+        order[b] = b;
+    }
+
+    qsort_r(order, nbuckets, sizeof(*order), _compare_buckets, sizes);
+
+    for (i = 0; ok && i < nbuckets && sizes[order[i]] > 0; i++) {
+        b = order[i];
+        nmembers = 0;
+
+        for (j = 0; j < count; j++) {
+            if (bucket_of[j] == b) {
+                members[nmembers++] = j;
+            }
+        }
+
+        for (seed = 1; seed < LDB_MAX_SEED; seed++) {
+            for (j = 0; j < nmembers; j++) {
+                tried[j] = _ldb_hash(strings[members[j]], seed) % count;
+
+                if (taken[tried[j]]) {
+                    break;
+                }
+
+                for (k = 0; k < j && tried[k] != tried[j]; k++) {
+                    ;
+                }
+
+                if (k < j) {
+                    break;
+                }
+            }
+
+            if (j == nmembers) {
+                break;
+            }
+        }
+
+        if (seed == LDB_MAX_SEED) {
+            ok = false;
+            break;
+        }
+
+        seeds[b] = seed;
+
+        for (j = 0; j < nmembers; j++) {
+            taken[tried[j]] = true;
+            slots[tried[j]] = members[j];
+        }
+    }
+
+    free(bucket_of);
+    free(sizes);
+    free(order);
+    free(members);
+    free(tried);
+    free(taken);
+    return ok;
+}
+
+/*
+ * Compile the JSON license database at json_path in to the binary
+ * format read by open_licensedb() and write it to out_path.  Returns 0
+ * on success, -1 on error.
+ */
+int compile_licensedb(const char *json_path, const char *out_path) {
+    struct json_object *json = NULL;
+    struct ldb_builder b;
+    struct ldb_header hdr;
+    string_map_t *offsets = NULL;
+    unsigned char *image = NULL;
+    uint32_t *table = NULL;
+    void *offset = NULL;
+    size_t size;
+    size_t len;
+    size_t n;
+    char *tmp = NULL;
+    FILE *fp = NULL;
+    int werr = 0;
+    int cerr = 0;
+    int ret = -1;
+    int i;
+
+    assert(json_path != NULL);
+    assert(out_path != NULL);
+
+    if ((json = _read_json(json_path)) == NULL) {
+        return -1;
+    }
+
+    memset(&b, 0, sizeof(b));
+    _walk_json(json, _add_to_builder, &b);
+
+    /* lay out the header and the string table, each string once */
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, LDB_MAGIC, sizeof(LDB_MAGIC));
+    hdr.version = LDB_VERSION;
+    hdr.strtab = sizeof(hdr);
+    offsets = string_map_new(b.count[LDB_NAMES] + b.count[LDB_ABBREVS]);
+
+    for (i = 0; i < LDB_NSETS; i++) {
+        b.count[i] = _unique_strings(b.strings[i], b.count[i]);
+
+        for (n = 0; n < b.count[i]; n++) {
+            if (string_map_add(offsets, b.strings[i][n], (void *) (uintptr_t) hdr.strtab_size)) {
+                hdr.strtab_size += strlen(b.strings[i][n]) + 1;
+            }
+        }
+    }
+
+    /* an empty string table still holds one NUL so it can be checked */
+    if (hdr.strtab_size == 0) {
+        hdr.strtab_size = 1;
+    }
+
+    size = (hdr.strtab + hdr.strtab_size + 3) & ~((size_t) 3);
+
+    for (i = 0; i < LDB_NSETS; i++) {
+        hdr.sets[i].count = b.count[i];
+        hdr.sets[i].nbuckets = b.count[i] / LDB_BUCKET_SIZE + 1;
+        hdr.sets[i].strings = size;
+        size += b.count[i] * sizeof(uint32_t);
+        hdr.sets[i].seeds = size;
+        size += hdr.sets[i].nbuckets * sizeof(uint32_t);
+        hdr.sets[i].slots = size;
+        size += b.count[i] * sizeof(uint32_t);
+    }
+
+    hdr.size = size;
+    image = calloc(1, size);
+    assert(image != NULL);
+
+    for (i = 0; i < LDB_NSETS; i++) {
+        table = (uint32_t *) (image + hdr.sets[i].strings);
+
+        for (n = 0; n < b.count[i]; n++) {
+            string_map_get(offsets, b.strings[i][n], &offset);
+            table[n] = (uint32_t) (uintptr_t) offset;
+            len = strlen(b.strings[i][n]) + 1;
+            memcpy(image + hdr.strtab + table[n], b.strings[i][n], len);
+        }
+
+        if (b.count[i] > 0 && !_build_perfect_hash(b.strings[i], b.count[i], hdr.sets[i].nbuckets,
+                                                   (uint32_t *) (image + hdr.sets[i].seeds),
+                                                   (uint32_t *) (image + hdr.sets[i].slots))) {
+            fprintf(stderr, "*** Unable to build a perfect hash for %s\n", json_path);
+            fflush(stderr);
+            goto cleanup;
+        }
+    }
+
+    hdr.checksum = _checksum(image + sizeof(hdr), size - sizeof(hdr));
+    memcpy(image, &hdr, sizeof(hdr));
+
+    /* write to a temporary file and rename it so readers never see half of it */
+    xasprintf(&tmp, "%s.XXXXXX", out_path);
+
+    if ((i = mkstemp(tmp)) == -1) {
+        fprintf(stderr, "*** Unable to create %s: %s\n", tmp, strerror(errno));
+        fflush(stderr);
+        goto cleanup;
+    }
+
+    if ((fp = fdopen(i, "w")) == NULL) {
+        fprintf(stderr, "*** Unable to open %s: %s\n", tmp, strerror(errno));
+        fflush(stderr);
+        close(i);
+        unlink(tmp);
+        goto cleanup;
+    }
+
+    /* always close the stream, a short write must not leak it */
+    errno = 0;
+
+    if (fwrite(image, 1, size, fp) != size) {
+        werr = errno ? errno : EIO;
+    }
+
+    if (fclose(fp) != 0) {
+        cerr = errno;
+    }
+
+    if (werr || cerr) {
+        if (werr) {
+            fprintf(stderr, "*** Error writing %s: %s\n", tmp, strerror(werr));
+        }
+
+        if (cerr) {
+            fprintf(stderr, "*** Error closing %s: %s\n", tmp, strerror(cerr));
+        }
+
+        fflush(stderr);
+        unlink(tmp);
+        goto cleanup;
+    }
+
+    chmod(tmp, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+    if (rename(tmp, out_path) == -1) {
+        fprintf(stderr, "*** Unable to rename %s to %s: %s\n", tmp, out_path, strerror(errno));
+        fflush(stderr);
+        unlink(tmp);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+cleanup:
+    free(tmp);
+    free(image);
+    string_map_free(offsets);
+
+    for (i = 0; i < LDB_NSETS; i++) {
+        free(b.strings[i]);
+    }
+
+    json_object_put(json);
+    return ret;
+}
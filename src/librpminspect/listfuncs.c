@@ -19,46 +19,21 @@
 #include "config.h"
 
 #include <assert.h>
-#include <errno.h>
-#include <search.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "rpminspect.h"
 
-static struct hsearch_data * list_to_table(const string_list_t *list)
+static string_map_t * list_to_table(const string_list_t *list)
 {
-    struct hsearch_data *table;
-    size_t table_size = 0;
-    ENTRY e;
-    ENTRY *eptr;
-
+    string_map_t *table;
     const string_entry_t *iter;
 
-    /* Iterate over the list once to get the size */
-    table_size = list_len(list);
-
-    /* Allocate the table */
-    table = calloc(1, sizeof(*table));
-    assert(table != NULL);
-
-    if (!hcreate_r(table_size, table)) {
-        fprintf(stderr, "Unable to create hash table: %s\n", strerror(errno));
-        free(table);
-        return NULL;
-    }
+    table = string_map_new(list_len(list));
 
     TAILQ_FOREACH(iter, list, items) {
-        e.key = iter->data;
-        e.data = iter->data;
-
-        if (!hsearch_r(e, ENTER, &eptr, table)) {
-            fprintf(stderr, "Unable to add entry to hash table: %s\n", strerror(errno));
-            hdestroy_r(table);
-            free(table);
-            return NULL;
-        }
+        string_map_add(table, iter->data, iter->data);
     }
 
     return table;
@@ -67,10 +42,7 @@ static struct hsearch_data * list_to_table(const string_list_t *list)
 /* Return a new list of entries that are in list a but are not in list b */
 string_list_t * list_difference(const string_list_t *a, const string_list_t *b)
 {
-    struct hsearch_data *b_table;
-
-    ENTRY e;
-    ENTRY *eptr;
+    string_map_t *b_table;
 
     const string_entry_t *iter;
     string_list_t *ret;
@@ -79,20 +51,13 @@ string_list_t * list_difference(const string_list_t *a, const string_list_t *b)
     /* Copy list b into a hash table */
     b_table = list_to_table(b);
 
-    if (b_table == NULL) {
-        return NULL;
-    }
-
     ret = malloc(sizeof(*ret));
     assert(ret != NULL);
     TAILQ_INIT(ret);
 
     /* Iterate through list a looking for things not in list b */
     TAILQ_FOREACH(iter, a, items) {
-        e.key = iter->data;
-        hsearch_r(e, FIND, &eptr, b_table);
-
-        if (eptr == NULL) {
+        if (!string_map_get(b_table, iter->data, NULL)) {
             entry = calloc(1, sizeof(*entry));
             assert(entry != NULL);
             entry->data = iter->data;
@@ -101,8 +66,7 @@ string_list_t * list_difference(const string_list_t *a, const string_list_t *b)
     }
 
     /* Free the hash table */
-    hdestroy_r(b_table);
-    free(b_table);
+    string_map_free(b_table);
 
     return ret;
 }
@@ -110,10 +74,7 @@ string_list_t * list_difference(const string_list_t *a, const string_list_t *b)
 /* Return a new list of entries that are both in list a and list b */
 string_list_t * list_intersection(const string_list_t *a, const string_list_t *b)
 {
-    struct hsearch_data *b_table;
-
-    ENTRY e;
-    ENTRY *eptr;
+    string_map_t *b_table;
 
     const string_entry_t *iter;
     string_list_t *ret;
@@ -122,20 +83,13 @@ string_list_t * list_intersection(const string_list_t *a, const string_list_t *b
     /* Copy list b into a hash table */
     b_table = list_to_table(b);
 
-    if (b_table == NULL) {
-        return NULL;
-    }
-
     ret = malloc(sizeof(*ret));
     assert(ret != NULL);
     TAILQ_INIT(ret);
 
     /* Iterate through list a looking for things in list b */
     TAILQ_FOREACH(iter, a, items) {
-        e.key = iter->data;
-        hsearch_r(e, FIND, &eptr, b_table);
-
-        if (eptr != NULL) {
+        if (string_map_get(b_table, iter->data, NULL)) {
             entry = calloc(1, sizeof(*entry));
             assert(entry != NULL);
             entry->data = iter->data;
@@ -144,8 +98,7 @@ string_list_t * list_intersection(const string_list_t *a, const string_list_t *b
     }
 
     /* Free the hash table */
-    hdestroy_r(b_table);
-    free(b_table);
+    string_map_free(b_table);
 
     return ret;
 }
@@ -153,39 +106,24 @@ string_list_t * list_intersection(const string_list_t *a, const string_list_t *b
 /* Return a new list of entries that are in either list a or list b */
 string_list_t * list_union(const string_list_t *a, const string_list_t *b)
 {
-    struct hsearch_data u_table;
-    size_t u_table_size = 0;
+    string_map_t *u_table;
 
     const string_entry_t *iter;
     string_list_t *ret;
     string_entry_t *entry;
 
-    ENTRY e;
-    ENTRY *eptr;
-
     ret = malloc(sizeof(*ret));
     assert(ret != NULL);
     TAILQ_INIT(ret);
 
-    u_table_size += list_len(a);
-    u_table_size += list_len(b);
-
-    if (!hcreate_r(u_table_size, &u_table)) {
-        fprintf(stderr, "Unable to create hash table: %s\n", strerror(errno));
-        return NULL;
-    }
+    u_table = string_map_new(list_len(a) + list_len(b));
 
     /*
      * Iterate over both lists, adding each entry to u_table. If it's not already in
      * u_table, add it to the list to be returned.
      */
     TAILQ_FOREACH(iter, a, items) {
-        e.key = iter->data;
-        e.data = iter->data;
-        hsearch_r(e, FIND, &eptr, &u_table);
-
-        if (eptr == NULL) {
-            hsearch_r(e, ENTER, &eptr, &u_table);
+        if (string_map_add(u_table, iter->data, iter->data)) {
             entry = calloc(1, sizeof(*entry));
             assert(entry != NULL);
             entry->data = iter->data;
@@ -194,12 +132,7 @@ string_list_t * list_union(const string_list_t *a, const string_list_t *b)
     }
 
     TAILQ_FOREACH(iter, b, items) {
-        e.key = iter->data;
-        e.data = iter->data;
-        hsearch_r(e, FIND, &eptr, &u_table);
-
-        if (eptr == NULL) {
-            hsearch_r(e, ENTER, &eptr, &u_table);
+        if (string_map_add(u_table, iter->data, iter->data)) {
             entry = calloc(1, sizeof(*entry));
             assert(entry != NULL);
             entry->data = iter->data;
@@ -207,7 +140,7 @@ string_list_t * list_union(const string_list_t *a, const string_list_t *b)
         }
     }
 
-    hdestroy_r(&u_table);
+    string_map_free(u_table);
 
     return ret;
 }
@@ -262,63 +195,73 @@ void list_free(string_list_t *list, list_entry_data_free_func free_func)
     free(list);
 }
 
+/* An entry and where it was in the list, so sorting can be stable */
+struct sort_entry {
+    char *data;
+    size_t pos;
+};
+
 static int compare_entries(const void *data1, const void *data2)
 {
-    const string_entry_t *entry1 = (const string_entry_t *) data1;
-    const string_entry_t *entry2 = (const string_entry_t *) data2;
+    const struct sort_entry *entry1 = (const struct sort_entry *) data1;
+    const struct sort_entry *entry2 = (const struct sort_entry *) data2;
+    int r = strcmp(entry1->data, entry2->data);
 
-    return strcmp(entry1->data, entry2->data);
-}
+    /* keep equal entries in list order so the first one is kept */
+    if (r == 0) {
+        r = (entry1->pos < entry2->pos) ? -1 : (entry1->pos > entry2->pos);
+    }
 
-/* tdestroy can't just take NULL for the free_node parameter, it has to have a no-op function */
-static void do_nothing(void *nodep __attribute__((unused)))
-{
-    return;
+    return r;
 }
 
 /* Return a sorted copy of the list.
  *
  * The data pointers used by the sorted list entries are the same as those
- * used in the original list.
+ * used in the original list.  Duplicate strings appear only once, using
+ * the first entry holding them.
  */
 string_list_t * list_sort(const string_list_t *list)
 {
     string_entry_t *iter;
+    string_entry_t *sorted_entry;
+    struct sort_entry *entries = NULL;
     string_list_t *sorted_list = NULL;
-    void *tree = NULL;
-
-    /* define the twalk action as a nested function so we can get to the sorted_list */
-    void walk_action(const void *nodep, const VISIT which, const int depth __attribute__((unused)))
-    {
-        string_entry_t *entry = *((string_entry_t **) nodep);
-        string_entry_t *sorted_entry;
-
-        if ((which == postorder) || (which == leaf)) {
-            sorted_entry = calloc(1, sizeof(*sorted_entry));
-            assert(sorted_entry != NULL);
-            sorted_entry->data = entry->data;
-            TAILQ_INSERT_TAIL(sorted_list, sorted_entry, items);
-        }
+    size_t len;
+    size_t i;
+
+    sorted_list = malloc(sizeof(*sorted_list));
+    assert(sorted_list != NULL);
+    TAILQ_INIT(sorted_list);
+
+    if ((len = list_len(list)) == 0) {
+        return sorted_list;
     }
 
+    entries = calloc(len, sizeof(*entries));
+    assert(entries != NULL);
+    i = 0;
 
-    /* copy entries into a tree to sort */
     TAILQ_FOREACH(iter, list, items) {
-        if (tsearch(iter, &tree, compare_entries) == NULL) {
-            goto cleanup;
-        }
+        entries[i].data = iter->data;
+        entries[i].pos = i;
+        i++;
     }
 
-    /* walk the tree to create a new sorted list */
-    sorted_list = malloc(sizeof(*sorted_list));
-    assert(sorted_list != NULL);
-    TAILQ_INIT(sorted_list);
-    twalk(tree, walk_action);
+    qsort(entries, len, sizeof(*entries), compare_entries);
+
+    for (i = 0; i < len; i++) {
+        if (i > 0 && !strcmp(entries[i - 1].data, entries[i].data)) {
+            continue;
+        }
 
-cleanup:
-    /* Free the tree */
-    tdestroy(tree, do_nothing);
+        sorted_entry = calloc(1, sizeof(*sorted_entry));
+        assert(sorted_entry != NULL);
+        sorted_entry->data = entries[i].data;
+        TAILQ_INSERT_TAIL(sorted_list, sorted_entry, items);
+    }
 
+    free(entries);
     return sorted_list;
 }
 
@@ -56,6 +56,14 @@ void free_rpmpeer(rpmpeer_t *peers) {
         entry->before_files = NULL;
         free_files(entry->after_files);
         entry->after_files = NULL;
+        free(entry->before_root);
+        entry->before_root = NULL;
+        free(entry->after_root);
+        entry->after_root = NULL;
+        free(entry->name);
+        entry->name = NULL;
+        free(entry->arch);
+        entry->arch = NULL;
         free(entry);
     }
 
@@ -65,85 +73,227 @@ void free_rpmpeer(rpmpeer_t *peers) {
 }
 
 /*
- * Add the specified package as a peer in the list of packages.
+ * Add the specified package as a peer in the list of packages (ri->peers).
  */
-void add_peer(rpmpeer_t **peers, int whichbuild, const char *pkg, Header *hdr) {
-    rpmpeer_entry_t *peer = NULL;
-    bool found = false;
-    char *newname = NULL;
-    char *newarch = NULL;
-    char *existingname = NULL;
-    char *existingarch = NULL;
+void add_peer(struct rpminspect *ri, int whichbuild, const char *pkg, Header *hdr) {
+    char *root = NULL;
 
-    assert(peers != NULL);
     assert(pkg != NULL);
     assert(hdr != NULL);
 
-    if (*peers == NULL) {
-        *peers = init_rpmpeer();
+    root = get_payload_dir(pkg);
+    add_peer_files(ri, whichbuild, pkg, hdr, root, extract_rpm(ri, pkg, *hdr, root));
+    free(root);
+    return;
+}
+
+/*
+ * Index of the peer list by package name and arch so add_peer_files()
+ * does not have to scan the whole list for every package.  Chained
+ * hash table, the bucket count is a power of two and doubles when the
+ * table gets full.
+ */
+typedef struct _peer_index_entry_t {
+    rpmpeer_entry_t *peer;
+    struct _peer_index_entry_t *next;
+} peer_index_entry_t;
+
+struct peer_index {
+    peer_index_entry_t **buckets;
+    size_t nbuckets;
+    size_t count;
+};
+
+#define PEER_INDEX_MIN_BUCKETS 64
+
+static size_t _hash_peer(const char *name, const char *arch) {
+    size_t hash = 5381;
+    const char *c = NULL;
+
+    for (c = name; *c != '\0'; c++) {
+        hash = (hash * 33) ^ (unsigned char) *c;
     }
 
-    /* Get the package or subpackage name and arch */
-    newname = headerGetAsString(*hdr, RPMTAG_NAME);
-    newarch = headerGetAsString(*hdr, RPMTAG_ARCH);
-
-    /* First, see if we already have this peer */
-    TAILQ_FOREACH(peer, *peers, items) {
-        if (whichbuild == BEFORE_BUILD && peer->before_rpm != NULL) {
-            existingname = peer->before_rpm;
-        } else if (whichbuild == AFTER_BUILD && peer->after_rpm != NULL) {
-            existingname = peer->after_rpm;
+    hash = (hash * 33) ^ '.';
+
+    for (c = arch; *c != '\0'; c++) {
+        hash = (hash * 33) ^ (unsigned char) *c;
+    }
+
+    return hash;
+}
+
+static void _grow_peer_index(struct peer_index *index) {
+    peer_index_entry_t **buckets = NULL;
+    peer_index_entry_t *entry = NULL;
+    peer_index_entry_t *next = NULL;
+    size_t nbuckets;
+    size_t i;
+    size_t b;
+
+    nbuckets = (index->nbuckets == 0) ? PEER_INDEX_MIN_BUCKETS : index->nbuckets * 2;
+    buckets = calloc(nbuckets, sizeof(*buckets));
+    assert(buckets != NULL);
+
+    for (i = 0; i < index->nbuckets; i++) {
+        for (entry = index->buckets[i]; entry != NULL; entry = next) {
+            next = entry->next;
+            b = _hash_peer(entry->peer->name, entry->peer->arch) & (nbuckets - 1);
+            entry->next = buckets[b];
+            buckets[b] = entry;
         }
+    }
 
-        if (existingname != NULL && !strcmp(pkg, existingname)) {
-            return;
+    free(index->buckets);
+    index->buckets = buckets;
+    index->nbuckets = nbuckets;
+    return;
+}
+
+/* Find the most recently added peer for name and arch */
+static rpmpeer_entry_t *_find_peer(const struct peer_index *index, const char *name, const char *arch) {
+    peer_index_entry_t *entry = NULL;
+
+    if (index == NULL || index->nbuckets == 0) {
+        return NULL;
+    }
+
+    for (entry = index->buckets[_hash_peer(name, arch) & (index->nbuckets - 1)]; entry != NULL; entry = entry->next) {
+        if (!strcmp(entry->peer->name, name) && !strcmp(entry->peer->arch, arch)) {
+            return entry->peer;
         }
     }
 
-    /* Second, if we don't have this peer, try to add it */
-    existingname = NULL;
+    return NULL;
+}
+
+static void _index_peer(struct peer_index *index, rpmpeer_entry_t *peer) {
+    peer_index_entry_t *entry = NULL;
+    size_t b;
+
+    if (index->count >= index->nbuckets) {
+        _grow_peer_index(index);
+    }
+
+    entry = calloc(1, sizeof(*entry));
+    assert(entry != NULL);
+    entry->peer = peer;
 
-    TAILQ_FOREACH(peer, *peers, items) {
-        if (whichbuild == BEFORE_BUILD && peer->after_rpm != NULL) {
-            existingname = headerGetAsString(peer->after_hdr, RPMTAG_NAME);
-            existingarch = headerGetAsString(peer->after_hdr, RPMTAG_ARCH);
-        } else if (whichbuild == AFTER_BUILD && peer->before_rpm != NULL) {
-            existingname = headerGetAsString(peer->before_hdr, RPMTAG_NAME);
-            existingarch = headerGetAsString(peer->before_hdr, RPMTAG_ARCH);
+    /* newest first, so _find_peer() returns the latest peer for a name */
+    b = _hash_peer(peer->name, peer->arch) & (index->nbuckets - 1);
+    entry->next = index->buckets[b];
+    index->buckets[b] = entry;
+    index->count++;
+    return;
+}
+
+/*
+ * Free the peer index.  The peers themselves belong to the peer list.
+ */
+void free_peer_index(struct peer_index *index) {
+    peer_index_entry_t *entry = NULL;
+    peer_index_entry_t *next = NULL;
+    size_t i;
+
+    if (index == NULL) {
+        return;
+    }
+
+    for (i = 0; i < index->nbuckets; i++) {
+        for (entry = index->buckets[i]; entry != NULL; entry = next) {
+            next = entry->next;
+            free(entry);
         }
+    }
+
+    free(index->buckets);
+    free(index);
+    return;
+}
+
+/*
+ * Like add_peer(), but for a package whose payload has already been
+ * extracted to root with extract_rpm().  The peer list takes over
+ * files.  This lets callers extract packages in parallel and still add
+ * them to the peer list in a fixed order.
+ *
+ * A package is paired with the peer of the other build that has the
+ * same name and arch.  Peers are found through ri->peer_index.
+ */
+void add_peer_files(struct rpminspect *ri, int whichbuild, const char *pkg, Header *hdr, const char *root, rpmfile_t *files) {
+    rpmpeer_entry_t *peer = NULL;
+    char *name = NULL;
+    char *arch = NULL;
+    const char *existing = NULL;
+
+    assert(ri != NULL);
+    assert(pkg != NULL);
+    assert(hdr != NULL);
+
+    if (ri->peers == NULL) {
+        ri->peers = init_rpmpeer();
+    }
+
+    if (ri->peer_index == NULL) {
+        ri->peer_index = calloc(1, sizeof(*ri->peer_index));
+        assert(ri->peer_index != NULL);
+    }
+
+    /* Get the package or subpackage name and arch */
+    name = headerGetAsString(*hdr, RPMTAG_NAME);
+    arch = headerGetAsString(*hdr, RPMTAG_ARCH);
+    assert(name != NULL);
+    assert(arch != NULL);
+
+    if ((peer = _find_peer(ri->peer_index, name, arch)) != NULL) {
+        existing = (whichbuild == BEFORE_BUILD) ? peer->before_rpm : peer->after_rpm;
 
-        if (existingname == NULL) {
-            continue;
+        /* we already have this package */
+        if (existing != NULL && !strcmp(pkg, existing)) {
+            free(name);
+            free(arch);
+            free_files(files);
+            return;
         }
 
-        if (!strcmp(existingname, newname) && !strcmp(existingarch, newarch)) {
-            /* found the existing peer */
-            found = true;
-            break;
+        /* another package by this name and arch, give it its own peer */
+        if (existing != NULL) {
+            peer = NULL;
         }
     }
 
-    /* Add the peer if it doesn't already exist, otherwise add it */
-    if (!found) {
+    /* Add the peer if it doesn't already exist */
+    if (peer == NULL) {
         if ((peer = calloc(1, sizeof(*peer))) == NULL) {
             fprintf(stderr, "*** failed to allocate new peer peer\n");
             fflush(stderr);
+            free(name);
+            free(arch);
+            free_files(files);
             return;
         }
+
+        peer->name = name;
+        peer->arch = arch;
+        TAILQ_INSERT_TAIL(ri->peers, peer, items);
+        _index_peer(ri->peer_index, peer);
+    } else {
+        free(name);
+        free(arch);
     }
 
     if (whichbuild == BEFORE_BUILD) {
         peer->before_hdr = headerCopy(*hdr);
         peer->before_rpm = strdup(pkg);
-        peer->before_files = extract_rpm(pkg, *hdr);
+        peer->before_files = files;
+        peer->before_root = strdup(root);
     } else if (whichbuild == AFTER_BUILD) {
         peer->after_hdr = headerCopy(*hdr);
         peer->after_rpm = strdup(pkg);
-        peer->after_files = extract_rpm(pkg, *hdr);
-    }
-
-    if (!found) {
-        TAILQ_INSERT_TAIL(*peers, peer, items);
+        peer->after_files = files;
+        peer->after_root = strdup(root);
+    } else {
+        free_files(files);
     }
 
     return;
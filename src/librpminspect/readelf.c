@@ -21,6 +21,7 @@
 
 #include <assert.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -48,22 +49,30 @@ Elf64_Half get_elf_type(Elf *elf)
     return ehdr.e_type;
 }
 
+static pthread_once_t elf_initialized = PTHREAD_ONCE_INIT;
+static bool elf_usable = false;
+
+/* library version check, done once no matter how many threads ask */
+static void init_libelf(void)
+{
+    if (elf_version(EV_CURRENT) == EV_NONE) {
+        fprintf(stderr, "libelf version mismatch\n");
+        return;
+    }
+
+    elf_usable = true;
+}
+
 static Elf * get_elf_with_kind(const char *fullpath, int *out_fd, Elf_Kind kind)
 {
     int fd;
     Elf *elf = NULL;
     struct stat sbuf;
 
-    static bool initialized = false;
+    pthread_once(&elf_initialized, init_libelf);
 
-    /* library version check */
-    if (!initialized) {
-        if (elf_version(EV_CURRENT) == EV_NONE) {
-            fprintf(stderr, "libelf version mismatch\n");
-            return NULL;
-        }
-
-        initialized = true;
+    if (!elf_usable) {
+        return NULL;
     }
 
     /* make sure this is a regular file */
@@ -108,6 +117,32 @@ Elf * get_elf_archive(const char *fullpath, int *out_fd)
     return get_elf_with_kind(fullpath, out_fd, ELF_K_AR);
 }
 
+/*
+ * Like get_elf(), but for an ELF object that has already been read into
+ * memory.  The buffer must remain valid until end_elf() is called.
+ */
+Elf * get_elf_memory(void *image, size_t size)
+{
+    Elf *elf = NULL;
+
+    pthread_once(&elf_initialized, init_libelf);
+
+    if (!elf_usable) {
+        return NULL;
+    }
+
+    if ((elf = elf_memory((char *) image, size)) == NULL) {
+        return NULL;
+    }
+
+    if (elf_kind(elf) == ELF_K_ELF) {
+        return elf;
+    }
+
+    elf_end(elf);
+    return NULL;
+}
+
 /*
  * Return true if a specified file is ELF, false otherwise.
  */
@@ -121,7 +156,7 @@ bool is_elf(const char *fullpath) {
         return false;
     }
 
-    elf_end(elf);
+    end_elf(elf);
     close(fd);
     return true;
 }
@@ -131,6 +166,176 @@ bool have_elf_section(Elf *elf, int64_t section, const char *name)
     return get_elf_section(elf, section, name, NULL, NULL) != NULL;
 }
 
+/*
+ * Section lookups go through an index built the first time a section
+ * of an object is asked for.  It keeps every section header and name
+ * and chains the sections together by name hash and by sh_type, so
+ * finding a section no longer walks and elf_strptr()s the whole table.
+ * Objects built with -ffunction-sections or LTO, and debug objects, can
+ * have many thousands of sections.
+ *
+ * An Elf is only ever used by the thread that opened it, so each thread
+ * keeps a short list of the indexes for the objects it has open.
+ * end_elf() drops the index along with the Elf.
+ */
+#define SECTION_TYPE_BUCKETS 32
+
+struct elf_section {
+    Elf_Scn *scn;
+    GElf_Shdr shdr;
+    const char *name;
+    uint32_t hash;
+    int32_t next_name;          /* next section in the same name bucket */
+    int32_t next_type;          /* next section in the same type bucket */
+};
+
+struct elf_section_index {
+    Elf *elf;
+    struct elf_section *sections;   /* sections[i] is section i + 1 */
+    size_t count;
+    int32_t *names;
+    size_t nnames;
+    int32_t types[SECTION_TYPE_BUCKETS];
+    struct elf_dynamic *dynamic;    /* decoded .dynamic, see get_elf_dynamic() */
+    bool dynamic_read;
+    struct elf_section_index *next;
+};
+
+static __thread struct elf_section_index *section_indexes = NULL;
+
+static uint32_t _hash_section_name(const char *name)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*name != '\0') {
+        hash ^= (unsigned char) *name++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static void _free_dynamic(struct elf_dynamic *dynamic)
+{
+    if (dynamic == NULL) {
+        return;
+    }
+
+    list_free(dynamic->needed, NULL);
+    free(dynamic->entries);
+    free(dynamic);
+    return;
+}
+
+static inline size_t _type_bucket(GElf_Word type)
+{
+    return (type * 2654435761u) >> 27;
+}
+
+static struct elf_section_index *_index_sections(Elf *elf)
+{
+    struct elf_section_index *index = NULL;
+    struct elf_section *section = NULL;
+    Elf_Scn *scn = NULL;
+    size_t shstrndx;
+    size_t shnum;
+    size_t bucket;
+    size_t i;
+
+    index = calloc(1, sizeof(*index));
+    assert(index != NULL);
+    index->elf = elf;
+    memset(index->types, -1, sizeof(index->types));
+
+    if (elf_getshdrstrndx(elf, &shstrndx) != 0 || elf_getshdrnum(elf, &shnum) != 0 || shnum < 2) {
+        return index;
+    }
+
+    index->sections = calloc(shnum - 1, sizeof(*index->sections));
+    assert(index->sections != NULL);
+
+    /* stop where a header cannot be read, as the old walk did */
+    while (index->count < shnum - 1 && (scn = elf_nextscn(elf, scn)) != NULL) {
+        section = &index->sections[index->count];
+
+        if (gelf_getshdr(scn, &section->shdr) != &section->shdr) {
+            break;
+        }
+
+        section->scn = scn;
+        section->name = elf_strptr(elf, shstrndx, section->shdr.sh_name);
+        section->hash = (section->name == NULL) ? 0 : _hash_section_name(section->name);
+        index->count++;
+    }
+
+    index->nnames = 16;
+
+    while (index->nnames < index->count) {
+        index->nnames *= 2;
+    }
+
+    index->names = malloc(index->nnames * sizeof(*index->names));
+    assert(index->names != NULL);
+    memset(index->names, -1, index->nnames * sizeof(*index->names));
+
+    /* chain back to front so every chain is in section order */
+    for (i = index->count; i-- > 0; ) {
+        section = &index->sections[i];
+        bucket = _type_bucket(section->shdr.sh_type);
+        section->next_type = index->types[bucket];
+        index->types[bucket] = i;
+
+        if (section->name != NULL) {
+            bucket = section->hash & (index->nnames - 1);
+            section->next_name = index->names[bucket];
+            index->names[bucket] = i;
+        } else {
+            section->next_name = -1;
+        }
+    }
+
+    return index;
+}
+
+static struct elf_section_index *_get_section_index(Elf *elf)
+{
+    struct elf_section_index *index = NULL;
+
+    for (index = section_indexes; index != NULL; index = index->next) {
+        if (index->elf == elf) {
+            return index;
+        }
+    }
+
+    index = _index_sections(elf);
+    index->next = section_indexes;
+    section_indexes = index;
+
+    return index;
+}
+
+/* Like elf_end(), but also forget the section index of the object */
+int end_elf(Elf *elf)
+{
+    struct elf_section_index **prev = &section_indexes;
+    struct elf_section_index *index = NULL;
+
+    while ((index = *prev) != NULL) {
+        if (index->elf == elf) {
+            *prev = index->next;
+            _free_dynamic(index->dynamic);
+            free(index->sections);
+            free(index->names);
+            free(index);
+            break;
+        }
+
+        prev = &index->next;
+    }
+
+    return elf_end(elf);
+}
+
 /*
  * Look through an ELF object by section for a section by the given ID and
  * the specified name.  At least one parameter is required.  To not specify
@@ -138,41 +343,265 @@ bool have_elf_section(Elf *elf, int64_t section, const char *name)
  * in NULL.
  */
 Elf_Scn * get_elf_section(Elf *elf, int64_t section, const char *name, Elf_Scn *start, GElf_Shdr *out_shdr) {
-    size_t shstrndx;
-    char *section_name = NULL;
-    Elf_Scn *scn = start;
-    GElf_Shdr shdr;
+    const struct elf_section_index *index = NULL;
+    const struct elf_section *found = NULL;
+    size_t after = 0;
+    uint32_t hash;
+    int32_t i;
+
+    index = _get_section_index(elf);
 
-    if (elf_getshdrstrndx(elf, &shstrndx) != 0) {
+    if (index->count == 0) {
         return NULL;
     }
 
-    /* we have an ELF object, iterate over the sections */
-    while ((scn = elf_nextscn(elf, scn)) != NULL) {
-        /* get this header information */
-        if (gelf_getshdr(scn, &shdr) != &shdr) {
-            return NULL;
+    /* sections up to and including start have already been seen */
+    if (start != NULL && (after = elf_ndxscn(start)) == SHN_UNDEF) {
+        return NULL;
+    }
+
+    if (name != NULL) {
+        hash = _hash_section_name(name);
+
+        for (i = index->names[hash & (index->nnames - 1)]; i != -1; i = index->sections[i].next_name) {
+            found = &index->sections[i];
+
+            if ((size_t) i >= after && found->hash == hash &&
+                    ((section < 0) || (found->shdr.sh_type == (GElf_Word) section)) &&
+                    !strcmp(name, found->name)) {
+                break;
+            }
+        }
+    } else if (section >= 0) {
+        for (i = index->types[_type_bucket(section)]; i != -1; i = index->sections[i].next_type) {
+            if ((size_t) i >= after && index->sections[i].shdr.sh_type == (GElf_Word) section) {
+                break;
+            }
+        }
+    } else {
+        i = (after < index->count) ? (int32_t) after : -1;
+    }
+
+    if (i == -1) {
+        return NULL;
+    }
+
+    found = &index->sections[i];
+
+    if (out_shdr != NULL) {
+        memcpy(out_shdr, &found->shdr, sizeof(*out_shdr));
+    }
+
+    return found->scn;
+}
+
+/* Decode the .dynamic section scn up to and including its DT_NULL terminator */
+static struct elf_dynamic *_read_dynamic(Elf *elf, Elf_Scn *scn, const GElf_Shdr *shdr)
+{
+    struct elf_dynamic *dynamic = NULL;
+    string_entry_t *entry = NULL;
+    Elf_Data *data = NULL;
+    GElf_Dyn dyn;
+    GElf_Dyn *dyn_tmp = NULL;
+    size_t entry_size;
+    size_t alloc = 0;
+    size_t i;
+    char *str = NULL;
+
+    dynamic = calloc(1, sizeof(*dynamic));
+    assert(dynamic != NULL);
+    memcpy(&dynamic->shdr, shdr, sizeof(dynamic->shdr));
+    dynamic->needed = malloc(sizeof(*dynamic->needed));
+    assert(dynamic->needed != NULL);
+    TAILQ_INIT(dynamic->needed);
+
+    while ((data = elf_getdata(scn, data)) != NULL) {
+        if (!(entry_size = gelf_fsize(elf, data->d_type, 1, EV_CURRENT))) {
+            continue;
         }
 
-        section_name = elf_strptr(elf, shstrndx, shdr.sh_name);
+        for (i = 0; i < data->d_size / entry_size; i++) {
+            if (gelf_getdyn(data, i, &dyn) == NULL) {
+                continue;
+            }
 
-        /* Check if this section matches the requested type and name */
-        if (((section < 0) || (shdr.sh_type == (GElf_Word) section)) &&
-                ((name == NULL) || ((section_name != NULL) && !strcmp(name, section_name)))) {
-            if (out_shdr != NULL) {
-                memcpy(out_shdr, &shdr, sizeof(*out_shdr));
+            if (dynamic->count == alloc) {
+                alloc = (alloc == 0) ? 32 : alloc * 2;
+                dyn_tmp = realloc(dynamic->entries, alloc * sizeof(*dynamic->entries));
+                assert(dyn_tmp != NULL);
+                dynamic->entries = dyn_tmp;
+            }
+
+            dynamic->entries[dynamic->count++] = dyn;
+
+            if (dyn.d_tag >= 0 && dyn.d_tag < 64) {
+                dynamic->tags |= (uint64_t) 1 << dyn.d_tag;
             }
 
-            return scn;
+            /* the terminator is kept as the last entry, padding after it is not */
+            if (dyn.d_tag == DT_NULL) {
+                return dynamic;
+            }
+
+            switch (dyn.d_tag) {
+                case DT_FLAGS:
+                    dynamic->flags = dyn.d_un.d_val;
+                    break;
+                case DT_FLAGS_1:
+                    dynamic->flags_1 = dyn.d_un.d_val;
+                    break;
+                case DT_NEEDED:
+                case DT_SONAME:
+                case DT_RPATH:
+                case DT_RUNPATH:
+                    if ((str = elf_strptr(elf, shdr->sh_link, dyn.d_un.d_val)) == NULL) {
+                        break;
+                    }
+
+                    if (dyn.d_tag == DT_SONAME) {
+                        dynamic->soname = str;
+                    } else if (dyn.d_tag == DT_RPATH) {
+                        dynamic->rpath = str;
+                    } else if (dyn.d_tag == DT_RUNPATH) {
+                        dynamic->runpath = str;
+                    } else {
+                        entry = calloc(1, sizeof(*entry));
+                        assert(entry != NULL);
+                        entry->data = str;
+                        TAILQ_INSERT_TAIL(dynamic->needed, entry, items);
+                    }
+
+                    break;
+                default:
+                    break;
+            }
         }
     }
 
-    return NULL;
+    return dynamic;
+}
+
+/*
+ * Return the decoded .dynamic section of the ELF object, or NULL if it
+ * has none.  The section is decoded the first time it is asked for and
+ * the result stays with the object until end_elf(), so any number of
+ * dynamic checks can be made without reading the section again.
+ */
+const struct elf_dynamic *get_elf_dynamic(Elf *elf)
+{
+    struct elf_section_index *index = NULL;
+    Elf_Scn *scn = NULL;
+    GElf_Shdr shdr;
+
+    index = _get_section_index(elf);
+
+    if (!index->dynamic_read) {
+        index->dynamic_read = true;
+
+        if ((scn = get_elf_section(elf, SHT_DYNAMIC, ".dynamic", NULL, &shdr)) != NULL) {
+            index->dynamic = _read_dynamic(elf, scn, &shdr);
+        }
+    }
+
+    return index->dynamic;
+}
+
+/* Does the decoded dynamic section have an entry with the given tag? */
+bool elf_dynamic_has_tag(const struct elf_dynamic *dynamic, const Elf64_Sxword tag)
+{
+    size_t i;
+
+    if (dynamic == NULL) {
+        return false;
+    }
+
+    if (tag >= 0 && tag < 64) {
+        return (dynamic->tags & ((uint64_t) 1 << tag)) != 0;
+    }
+
+    for (i = 0; i < dynamic->count; i++) {
+        if (dynamic->entries[i].d_tag == tag) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Fill in summary for the given ELF object.  The program headers and
+ * the section headers are each walked once, so the predicates in
+ * inspect_elf.c do not have to go back to libelf.  Where an object has
+ * more than one PT_GNU_STACK header or .note.GNU-stack section, the
+ * first one wins, as it did with get_elf_phdr() and get_elf_section().
+ * Returns false if the ELF header cannot be read.
+ */
+bool get_elf_summary(Elf *elf, struct elf_summary *summary)
+{
+    GElf_Ehdr ehdr;
+    GElf_Phdr phdr;
+    const struct elf_section_index *index = NULL;
+    const struct elf_section *section = NULL;
+    const struct elf_dynamic *dynamic = NULL;
+    size_t phnum;
+    size_t i;
+
+    assert(summary != NULL);
+    memset(summary, 0, sizeof(*summary));
+
+    if (gelf_getehdr(elf, &ehdr) == NULL) {
+        return false;
+    }
+
+    summary->type = ehdr.e_type;
+    summary->machine = ehdr.e_machine;
+
+    if (elf_getphdrnum(elf, &phnum) == 0) {
+        for (i = 0; i < phnum; i++) {
+            if (gelf_getphdr(elf, i, &phdr) == NULL) {
+                break;
+            }
+
+            if (phdr.p_type == PT_GNU_STACK && !summary->stack_phdr) {
+                summary->stack_phdr = true;
+                summary->stack_phdr_flags = phdr.p_flags;
+            } else if (phdr.p_type == PT_GNU_RELRO) {
+                summary->relro = true;
+            }
+        }
+    }
+
+    index = _get_section_index(elf);
+
+    for (i = 0; i < index->count; i++) {
+        section = &index->sections[i];
+
+        if (section->shdr.sh_type != SHT_PROGBITS) {
+            continue;
+        }
+
+        if (section->shdr.sh_flags & SHF_EXECINSTR) {
+            summary->executable_code = true;
+        }
+
+        if (!summary->stack_note && section->name != NULL && !strcmp(section->name, ".note.GNU-stack")) {
+            summary->stack_note = true;
+            summary->stack_note_flags = section->shdr.sh_flags;
+        }
+    }
+
+    if ((dynamic = get_elf_dynamic(elf)) != NULL) {
+        summary->dynamic = true;
+        summary->textrel = elf_dynamic_has_tag(dynamic, DT_TEXTREL);
+        summary->bind_now = elf_dynamic_has_tag(dynamic, DT_BIND_NOW);
+    }
+
+    return true;
 }
 
 bool have_dynamic_tag(Elf *elf, const Elf64_Sxword tag)
 {
-    return get_dynamic_tags(elf, tag, NULL, NULL, NULL);
+    return elf_dynamic_has_tag(get_elf_dynamic(elf), tag);
 }
 
 /* Return the requested dynamic tags.
@@ -184,56 +613,39 @@ bool have_dynamic_tag(Elf *elf, const Elf64_Sxword tag)
  */
 bool get_dynamic_tags(Elf *elf, const Elf64_Sxword tag, GElf_Dyn **out, size_t *out_size, GElf_Shdr *shdr_out)
 {
-    Elf_Scn *dyn_section;
-    GElf_Shdr shdr;
-    Elf_Data *data = NULL;
-    GElf_Dyn dyn;
+    const struct elf_dynamic *dynamic = NULL;
     GElf_Dyn *dyn_tmp;
-
-    size_t entry_size;
     size_t i;
-
     bool found = false;
 
-    dyn_section = get_elf_section(elf, SHT_DYNAMIC, ".dynamic", NULL, &shdr);
-
-    if (dyn_section == NULL) {
+    if ((dynamic = get_elf_dynamic(elf)) == NULL) {
         return false;
     }
 
     if (shdr_out != NULL) {
-        memcpy(shdr_out, &shdr, sizeof(*shdr_out));
+        memcpy(shdr_out, &dynamic->shdr, sizeof(*shdr_out));
     }
 
-    if (out != NULL) {
-        *out = NULL;
-        *out_size = 0;
+    if (out == NULL) {
+        return elf_dynamic_has_tag(dynamic, tag);
     }
 
-    while ((data = elf_getdata(dyn_section, data)) != NULL) {
-        entry_size = gelf_fsize(elf, data->d_type, 1, EV_CURRENT);
-
-        for (i = 0; i < shdr.sh_size / entry_size; i++) {
-            if (gelf_getdyn(data, i, &dyn) == NULL) {
-                continue;
-            }
+    *out = NULL;
+    *out_size = 0;
 
-            if (dyn.d_tag == tag) {
-                /* If no data was requested, just return now */
-                if (out == NULL) {
-                    return true;
-                }
+    for (i = 0; i < dynamic->count; i++) {
+        if (dynamic->entries[i].d_tag != tag) {
+            continue;
+        }
 
-                found = true;
+        found = true;
 
-                /* alloc one more GElf_Dyn worth of memory and add to the end of the array */
-                dyn_tmp = realloc(*out, ((*out_size) + 1) * (sizeof(GElf_Dyn)));
-                assert(dyn_tmp != NULL);
-                memcpy(dyn_tmp + *out_size, &dyn, sizeof(GElf_Dyn));
-                *out = dyn_tmp;
-                (*out_size)++;
-           }
-        }
+        /* alloc one more GElf_Dyn worth of memory and add to the end of the array */
+        dyn_tmp = realloc(*out, ((*out_size) + 1) * (sizeof(GElf_Dyn)));
+        assert(dyn_tmp != NULL);
+        memcpy(dyn_tmp + *out_size, &dynamic->entries[i], sizeof(GElf_Dyn));
+        *out = dyn_tmp;
+        (*out_size)++;
     }
 
     return found;
@@ -391,7 +803,7 @@ void elf_archive_iterate(int fd, Elf *archive, elf_ar_action action, void *user_
     while ((elf = elf_begin(fd, cmd, archive)) != NULL) {
         result = action(elf, user_data);
         cmd = elf_next(elf);
-        elf_end(elf);
+        end_elf(elf);
 
         if (!result) {
             break;
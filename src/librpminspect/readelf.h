@@ -27,8 +27,46 @@
 
 #include "types.h"
 
+/*
+ * What the ELF inspections need to know about an object, collected by
+ * get_elf_summary() in a single pass over the ELF header, program
+ * headers, section headers and the dynamic section.
+ */
+struct elf_summary {
+    Elf64_Half type;                /* e_type */
+    Elf64_Half machine;             /* e_machine */
+    bool executable_code;           /* SHT_PROGBITS with SHF_EXECINSTR */
+    bool stack_note;                /* .note.GNU-stack section */
+    uint64_t stack_note_flags;      /* its sh_flags */
+    bool stack_phdr;                /* PT_GNU_STACK program header */
+    uint64_t stack_phdr_flags;      /* its p_flags */
+    bool relro;                     /* PT_GNU_RELRO program header */
+    bool dynamic;                   /* .dynamic section */
+    bool textrel;                   /* DT_TEXTREL */
+    bool bind_now;                  /* DT_BIND_NOW */
+};
+
+/*
+ * The .dynamic section of an object, decoded once by get_elf_dynamic().
+ * Strings point into the object and are valid until end_elf().
+ */
+struct elf_dynamic {
+    GElf_Shdr shdr;                 /* the .dynamic section header */
+    GElf_Dyn *entries;              /* every entry through the first DT_NULL */
+    size_t count;
+    uint64_t tags;                  /* bit n is set if tag n < 64 is present */
+    GElf_Xword flags;               /* DT_FLAGS, or 0 */
+    GElf_Xword flags_1;             /* DT_FLAGS_1, or 0 */
+    const char *soname;             /* DT_SONAME, or NULL */
+    const char *rpath;              /* DT_RPATH, or NULL */
+    const char *runpath;            /* DT_RUNPATH, or NULL */
+    string_list_t *needed;          /* DT_NEEDED entries in order */
+};
+
 Elf * get_elf(const char *, int *);
 Elf * get_elf_archive(const char *, int *);
+Elf * get_elf_memory(void *, size_t);
+int end_elf(Elf *);
 Elf64_Half get_elf_type(Elf *);
 bool is_elf(const char *);
 bool have_elf_section(Elf *, int64_t, const char *);
@@ -36,6 +74,10 @@ Elf_Scn * get_elf_section(Elf *, int64_t, const char *, Elf_Scn *, GElf_Shdr *);
 Elf_Scn * get_elf_extended_section(Elf *, Elf_Scn *, GElf_Shdr *);
 GElf_Phdr * get_elf_phdr(Elf *, Elf64_Word, GElf_Phdr *);
 
+bool get_elf_summary(Elf *, struct elf_summary *);
+
+const struct elf_dynamic *get_elf_dynamic(Elf *);
+bool elf_dynamic_has_tag(const struct elf_dynamic *, const Elf64_Sxword);
 bool have_dynamic_tag(Elf *, const Elf64_Sxword);
 bool get_dynamic_tags(Elf *, const Elf64_Sxword, GElf_Dyn **, size_t *, GElf_Shdr *);
 
@@ -18,9 +18,16 @@
 
 #include "config.h"
 
+#include <pthread.h>
 #include <sys/queue.h>
 #include "rpminspect.h"
 
+/*
+ * Inspections may add results from more than one thread at a time,
+ * so changes to a results list are serialized.
+ */
+static pthread_mutex_t results_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /*
  * Initialize a new results_t list.
  */
@@ -82,10 +89,6 @@ void add_result(results_t **results, severity_t severity,
     assert(header != NULL);
     assert(msg != NULL);
 
-    if (*results == NULL) {
-        *results = init_results();
-    }
-
     entry = calloc(1, sizeof(*entry));
     assert(entry != NULL);
 
@@ -102,6 +105,41 @@ void add_result(results_t **results, severity_t severity,
         entry->remedy = strdup(remedy);
     }
 
+    pthread_mutex_lock(&results_lock);
+
+    if (*results == NULL) {
+        *results = init_results();
+    }
+
     TAILQ_INSERT_TAIL((*results), entry, items);
+    pthread_mutex_unlock(&results_lock);
+
+    return;
+}
+
+/*
+ * Move all of the entries in src to the end of dest, preserving their
+ * order, and free src.  Used to combine results collected separately
+ * (e.g., by concurrently running inspections) in a fixed order.
+ */
+void merge_results(results_t **dest, results_t *src) {
+    assert(dest != NULL);
+
+    if (src == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&results_lock);
+
+    if (*dest == NULL) {
+        *dest = src;
+        src = NULL;
+    } else {
+        TAILQ_CONCAT(*dest, src, items);
+    }
+
+    pthread_mutex_unlock(&results_lock);
+
+    free(src);
     return;
 }
@@ -57,6 +57,9 @@
 #define REMEDY_MAN_ERRORS   "Correct the errors in the manpage as reported by the libmandoc parser"
 #define REMEDY_MAN_PATH     "Correct the installation path for the man page. Man pages must be installed in the directory beneath /usr/share/man that matches the section number of the page."
 
+/* payload */
+#define REMEDY_PAYLOAD      "Make sure the package is complete and not corrupt; rebuild or download it again"
+
 /* xml */
 #define REMEDY_XML          "Correct the reported errors in the XML document"
 
@@ -18,6 +18,7 @@
 
 #include "config.h"
 
+#include <pthread.h>
 #include <stdbool.h>
 #include <rpm/rpmlib.h>
 #include <rpm/rpmts.h>
@@ -41,6 +42,14 @@ int init_librpm(void)
     return result;
 }
 
+/*
+ * librpm does not document its transaction set, macro and keyring state
+ * as thread safe, so packages are read one at a time.  Only the header
+ * read is serialized; the payload is unpacked with libarchive outside
+ * of the lock.
+ */
+static pthread_mutex_t rpm_read_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /* Return an RPM header struct for the given package filename. */
 int get_rpm_header(const char *pkg, Header *hdr) {
     rpmts ts;
@@ -49,6 +58,7 @@ int get_rpm_header(const char *pkg, Header *hdr) {
 
     assert(pkg != NULL);
 
+    pthread_mutex_lock(&rpm_read_lock);
     fd = Fopen(pkg, "r.ufdio");
 
     if (fd == NULL || Ferror(fd)) {
@@ -59,6 +69,7 @@ int get_rpm_header(const char *pkg, Header *hdr) {
             Fclose(fd);
         }
 
+        pthread_mutex_unlock(&rpm_read_lock);
         return -1;
     }
 
@@ -69,6 +80,7 @@ int get_rpm_header(const char *pkg, Header *hdr) {
 
     rpmtsFree(ts);
     Fclose(fd);
+    pthread_mutex_unlock(&rpm_read_lock);
 
     if (result == RPMRC_OK) {
         return 0;
@@ -74,6 +74,30 @@ size_t list_len(const string_list_t *);
 string_list_t * list_sort(const string_list_t *);
 string_list_t * list_copy(const string_list_t *);
 
+/* strmap.c */
+string_map_t *string_map_new(size_t);
+bool string_map_add(string_map_t *, const char *, void *);
+bool string_map_get(const string_map_t *, const char *, void **);
+void string_map_free(string_map_t *);
+
+/* scanner.c */
+#define SCAN_WORD_START 0x01   /* literal must start at a word boundary */
+#define SCAN_WORD_END   0x02   /* literal must end at a word boundary */
+typedef bool (*scanner_match_func)(size_t, size_t, size_t, void *);
+scanner_t *scanner_new(void);
+size_t scanner_add(scanner_t *, const char *, unsigned int);
+void scanner_compile(scanner_t *);
+bool scanner_scan(const scanner_t *, const char *, size_t, scanner_match_func, void *);
+bool scanner_contains(const scanner_t *, const char *);
+void scanner_free(scanner_t *);
+
+/* licensedb.c */
+licensedb_t *open_licensedb(const char *);
+bool is_license_name(const licensedb_t *, const char *);
+bool is_license_abbrev(const licensedb_t *, const char *);
+void close_licensedb(licensedb_t *);
+int compile_licensedb(const char *, const char *);
+
 /* local.c */
 bool is_local_build(const char *);
 
@@ -97,10 +121,27 @@ char *strseverity(const severity_t);
 char *strwaiverauth(const waiverauth_t);
 
 /* badwords.c */
-bool has_bad_word(const char *, const string_list_t *);
+int compile_bad_words(const string_list_t *, regex_t **);
+scanner_t *scan_bad_words(const char *);
+bool has_bad_word(const char *, const struct rpminspect *);
+
+/* cache.c */
+char *get_cached_rpm(const struct rpminspect *, const koji_rpmlist_entry_t *);
+void add_cached_rpm(const struct rpminspect *, const koji_rpmlist_entry_t *, const char *, Header);
+void trim_cache(const struct rpminspect *);
+struct koji_build *get_cached_koji_build(const struct rpminspect *, const char *);
+void add_cached_koji_build(const struct rpminspect *, const char *, const struct koji_build *);
+
+/* arena.c */
+struct arena *arena_new(void);
+void *arena_alloc(struct arena *, size_t);
+char *arena_strdup(struct arena *, const char *);
+char *arena_sprintf(struct arena *, const char *, ...);
+void arena_free(struct arena *);
 
 /* copyfile.c */
 int copyfile(const char *, const char *, bool, bool);
+int ingestfile(const char *, const char *);
 
 /* rpm.c */
 int init_librpm(void);
@@ -109,12 +150,21 @@ int get_rpm_header(const char *, Header *);
 /* peers.c */
 rpmpeer_t *init_rpmpeer(void);
 void free_rpmpeer(rpmpeer_t *);
-void add_peer(rpmpeer_t **, int, const char *, Header *);
+void add_peer(struct rpminspect *, int, const char *, Header *);
+void add_peer_files(struct rpminspect *, int, const char *, Header *, const char *, rpmfile_t *);
+void free_peer_index(struct peer_index *);
 
 /* files.c */
 void free_files(rpmfile_t *files);
-rpmfile_t * extract_rpm(const char *, Header);
+char *get_payload_dir(const char *);
+rpmfile_t * extract_rpm(const struct rpminspect *, const char *, Header, const char *);
+const rpmfile_table_t *get_file_table(rpmfile_t *);
 const char * get_file_path(const rpmfile_entry_t *file);
+typedef bool (*payload_file_func)(rpmfile_entry_t *, void *);
+typedef bool (*payload_want_func)(rpmfile_entry_t *, const unsigned char *, size_t, void *);
+bool foreach_payload_file(const char *, rpmfile_t *, payload_want_func, payload_file_func, void *);
+bool write_file_contents(const char *, rpmfile_t *, rpmfile_entry_t *);
+bool process_path(const char *, regex_t *, regex_t *);
 bool process_file_path(const rpmfile_entry_t *, regex_t *, regex_t *);
 
 /* tty.c */
@@ -124,6 +174,11 @@ size_t tty_width(void);
 results_t *init_results(void);
 void free_results(results_t *);
 void add_result(results_t **, severity_t, waiverauth_t, char *, char *, char *, char *);
+void merge_results(results_t **, results_t *);
+
+/* jobs.c */
+typedef void (*job_func)(void *, unsigned int, size_t);
+void run_jobs(unsigned int, size_t, job_func, void *);
 
 /* output_text.c */
 void output_text(const results_t *, const char *);
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2019  Red Hat, Inc.
+ * Author(s):  David Cantrell <dcantrell@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Case insensitive multi-pattern literal scanner (Aho-Corasick).  Add
+ * the literals with scanner_add(), call scanner_compile() once, and
+ * then any number of threads may scan text with it at the same time.
+ * A text is scanned in one pass no matter how many literals there are.
+ *
+ * Case folding is ASCII only.  A literal can require a word boundary,
+ * in the sense of \b in a regular expression, before or after it, so
+ * "\bword" and "word\b" can be matched without a regex engine.  Word
+ * characters are ASCII letters, digits and the underscore.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rpminspect.h"
+
+/* One trie node, compiled into a DFA state by scanner_compile() */
+struct scanner_node {
+    int32_t next[256];
+    int32_t fail;
+    int32_t output;            /* first pattern ending here, or -1 */
+    int32_t dict;              /* nearest fail state with output, or -1 */
+};
+
+struct scanner_pattern {
+    size_t len;
+    unsigned int flags;
+    int32_t next;              /* next pattern ending at the same node */
+};
+
+struct scanner {
+    struct scanner_node *nodes;
+    size_t nnodes;
+    size_t nodes_alloc;
+    struct scanner_pattern *patterns;
+    size_t npatterns;
+    bool compiled;
+};
+
+static int32_t _new_node(scanner_t *scanner) {
+    struct scanner_node *node = NULL;
+
+    if (scanner->nnodes == scanner->nodes_alloc) {
+        scanner->nodes_alloc = (scanner->nodes_alloc == 0) ? 16 : scanner->nodes_alloc * 2;
+        scanner->nodes = realloc(scanner->nodes, scanner->nodes_alloc * sizeof(*scanner->nodes));
+        assert(scanner->nodes != NULL);
+    }
+
+    node = &scanner->nodes[scanner->nnodes];
+    memset(node->next, -1, sizeof(node->next));
+    node->fail = 0;
+    node->output = -1;
+    node->dict = -1;
+
+    return scanner->nnodes++;
+}
+
+static inline bool _is_word(unsigned char c) {
+    return isascii(c) && (isalnum(c) || c == '_');
+}
+
+static inline unsigned char _fold(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+/* Is there a word boundary in front of text[pos]? */
+static bool _is_boundary(const char *text, size_t len, size_t pos) {
+    bool before = (pos > 0) && _is_word(text[pos - 1]);
+    bool after = (pos < len) && _is_word(text[pos]);
+
+    return before != after;
+}
+
+scanner_t *scanner_new(void) {
+    scanner_t *scanner = NULL;
+
+    scanner = calloc(1, sizeof(*scanner));
+    assert(scanner != NULL);
+
+    /* the root */
+    _new_node(scanner);
+
+    return scanner;
+}
+
+/*
+ * Add a literal to look for.  flags is zero or more of SCAN_WORD_START
+ * and SCAN_WORD_END.  Returns the number of the pattern, which is
+ * handed to the match callback of scanner_scan().  All literals must
+ * be added before scanner_compile() is called.
+ */
+size_t scanner_add(scanner_t *scanner, const char *literal, unsigned int flags) {
+    const unsigned char *c = NULL;
+    struct scanner_pattern *pattern = NULL;
+    int32_t state = 0;
+    int32_t next;
+
+    assert(scanner != NULL);
+    assert(literal != NULL && *literal != '\0');
+    assert(!scanner->compiled);
+
+    for (c = (const unsigned char *) literal; *c != '\0'; c++) {
+        if ((next = scanner->nodes[state].next[_fold(*c)]) == -1) {
+            next = _new_node(scanner);
+            scanner->nodes[state].next[_fold(*c)] = next;
+        }
+
+        state = next;
+    }
+
+    scanner->patterns = realloc(scanner->patterns, (scanner->npatterns + 1) * sizeof(*scanner->patterns));
+    assert(scanner->patterns != NULL);
+    pattern = &scanner->patterns[scanner->npatterns];
+    pattern->len = strlen(literal);
+    pattern->flags = flags;
+    pattern->next = scanner->nodes[state].output;
+    scanner->nodes[state].output = scanner->npatterns;
+
+    return scanner->npatterns++;
+}
+
+/*
+ * Compute the failure links and turn the trie into a DFA so scanning
+ * takes exactly one transition per input byte.
+ */
+void scanner_compile(scanner_t *scanner) {
+    int32_t *queue = NULL;
+    size_t head = 0;
+    size_t tail = 0;
+    struct scanner_node *node = NULL;
+    int32_t state;
+    int32_t child;
+    int32_t fail;
+    int c;
+
+    assert(scanner != NULL);
+
+    if (scanner->compiled) {
+        return;
+    }
+
+    queue = calloc(scanner->nnodes, sizeof(*queue));
+    assert(queue != NULL);
+
+    /* children of the root fail back to the root */
+    for (c = 0; c < 256; c++) {
+        if ((child = scanner->nodes[0].next[c]) == -1) {
+            scanner->nodes[0].next[c] = 0;
+        } else {
+            scanner->nodes[child].fail = 0;
+            queue[tail++] = child;
+        }
+    }
+
+    /* breadth first, so every fail state is done before it is used */
+    while (head < tail) {
+        state = queue[head++];
+        node = &scanner->nodes[state];
+        fail = node->fail;
+        node->dict = (scanner->nodes[fail].output != -1) ? fail : scanner->nodes[fail].dict;
+
+        for (c = 0; c < 256; c++) {
+            child = node->next[c];
+
+            if (child == -1) {
+                node->next[c] = scanner->nodes[fail].next[c];
+            } else {
+                scanner->nodes[child].fail = scanner->nodes[fail].next[c];
+                queue[tail++] = child;
+            }
+        }
+    }
+
+    free(queue);
+    scanner->compiled = true;
+    return;
+}
+
+/*
+ * Scan len bytes of text and call func for every match, in the order
+ * the matches end.  func returns false to stop the scan.  Returns true
+ * if anything matched.
+ */
+bool scanner_scan(const scanner_t *scanner, const char *text, size_t len, scanner_match_func func, void *data) {
+    const struct scanner_pattern *pattern = NULL;
+    int32_t state = 0;
+    int32_t out;
+    int32_t p;
+    size_t start;
+    size_t i;
+    bool found = false;
+
+    assert(scanner != NULL);
+    assert(scanner->compiled);
+    assert(text != NULL || len == 0);
+
+    for (i = 0; i < len; i++) {
+        state = scanner->nodes[state].next[_fold(text[i])];
+
+        for (out = state; out > 0; out = scanner->nodes[out].dict) {
+            for (p = scanner->nodes[out].output; p != -1; p = pattern->next) {
+                pattern = &scanner->patterns[p];
+                start = i + 1 - pattern->len;
+
+                if ((pattern->flags & SCAN_WORD_START) && !_is_boundary(text, len, start)) {
+                    continue;
+                }
+
+                if ((pattern->flags & SCAN_WORD_END) && !_is_boundary(text, len, i + 1)) {
+                    continue;
+                }
+
+                found = true;
+
+                if (func == NULL || !func(start, pattern->len, p, data)) {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return found;
+}
+
+/* Does text contain any of the literals? */
+bool scanner_contains(const scanner_t *scanner, const char *text) {
+    assert(text != NULL);
+    return scanner_scan(scanner, text, strlen(text), NULL, NULL);
+}
+
+void scanner_free(scanner_t *scanner) {
+    if (scanner == NULL) {
+        return;
+    }
+
+    free(scanner->nodes);
+    free(scanner->patterns);
+    free(scanner);
+    return;
+}
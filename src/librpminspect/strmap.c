@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2019  Red Hat, Inc.
+ * Author(s):  David Cantrell <dcantrell@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A small string keyed hash table used in place of hsearch_r().
+ * hsearch_r() tables cannot grow, slow down badly as they fill up and
+ * only allow one table per hsearch_data with no way to walk it.  This
+ * one uses open addressing with linear probing, grows to keep the load
+ * factor under 0.7 and stores the full hash of each key so a probe only
+ * calls strcmp() on a likely match.
+ *
+ * Keys are not copied.  The caller keeps them alive for as long as the
+ * map is used.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rpminspect.h"
+
+#define STRING_MAP_MIN_SLOTS 16
+
+struct string_map_slot {
+    const char *key;
+    void *data;
+    uint64_t hash;
+};
+
+struct string_map {
+    struct string_map_slot *slots;
+    size_t nslots;
+    size_t count;
+};
+
+/* Multiply to 128 bits and fold the high half into the low half */
+static inline uint64_t _mix(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t) a * b;
+    return (uint64_t) (r >> 64) ^ (uint64_t) r;
+#else
+    /* 32-bit targets have no 128-bit type, build the product by halves */
+    uint64_t alo = a & 0xffffffffu;
+    uint64_t ahi = a >> 32;
+    uint64_t blo = b & 0xffffffffu;
+    uint64_t bhi = b >> 32;
+    uint64_t ll = alo * blo;
+    uint64_t lh = alo * bhi;
+    uint64_t hl = ahi * blo;
+    uint64_t hh = ahi * bhi;
+    uint64_t mid = (ll >> 32) + (lh & 0xffffffffu) + (hl & 0xffffffffu);
+    uint64_t hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+    uint64_t lo = (mid << 32) | (ll & 0xffffffffu);
+
+    return hi ^ lo;
+#endif
+}
+
+/*
+ * Hash a string 8 bytes at a time with a multiply and fold mixer in
+ * the style of wyhash.  Much better spread than the additive hash
+ * hsearch_r() uses, and cheap for the long paths found in packages.
+ */
+static uint64_t _hash_string(const char *key) {
+    const uint64_t k0 = 0xa0761d6478bd642full;
+    const uint64_t k1 = 0xe7037ed1a0b428dbull;
+    uint64_t hash = k0;
+    uint64_t word;
+    size_t len = strlen(key);
+    size_t n = len;
+    const char *p = key;
+
+    while (n >= 8) {
+        memcpy(&word, p, 8);
+        hash = _mix(hash ^ word, k1);
+        p += 8;
+        n -= 8;
+    }
+
+    word = 0;
+    memcpy(&word, p, n);
+    hash = _mix(hash ^ word ^ ((uint64_t) len << 56), k1);
+
+    return _mix(hash, k0);
+}
+
+/* Find the slot holding key, or the empty slot where it would go */
+static struct string_map_slot *_find_slot(struct string_map_slot *slots, size_t nslots, const char *key, uint64_t hash) {
+    size_t i = hash & (nslots - 1);
+
+    while (slots[i].key != NULL) {
+        if (slots[i].hash == hash && !strcmp(slots[i].key, key)) {
+            break;
+        }
+
+        i = (i + 1) & (nslots - 1);
+    }
+
+    return &slots[i];
+}
+
+static void _resize(string_map_t *map, size_t nslots) {
+    struct string_map_slot *slots = NULL;
+    struct string_map_slot *slot = NULL;
+    size_t i;
+
+    slots = calloc(nslots, sizeof(*slots));
+    assert(slots != NULL);
+
+    for (i = 0; i < map->nslots; i++) {
+        if (map->slots[i].key == NULL) {
+            continue;
+        }
+
+        slot = _find_slot(slots, nslots, map->slots[i].key, map->slots[i].hash);
+        *slot = map->slots[i];
+    }
+
+    free(map->slots);
+    map->slots = slots;
+    map->nslots = nslots;
+    return;
+}
+
+/* Does adding one more key push the load factor over 0.7? */
+static inline bool _needs_grow(const string_map_t *map) {
+    return (map->count + 1) * 10 > map->nslots * 7;
+}
+
+/*
+ * Create a new map with room for at least size keys before it has to
+ * grow.  size may be 0.
+ */
+string_map_t *string_map_new(size_t size) {
+    string_map_t *map = NULL;
+    size_t nslots = STRING_MAP_MIN_SLOTS;
+
+    while (size * 10 > nslots * 7) {
+        nslots *= 2;
+    }
+
+    map = calloc(1, sizeof(*map));
+    assert(map != NULL);
+    map->slots = calloc(nslots, sizeof(*map->slots));
+    assert(map->slots != NULL);
+    map->nslots = nslots;
+
+    return map;
+}
+
+/*
+ * Add key to the map with data.  Returns false and leaves the map as
+ * it was if key is already present.
+ */
+bool string_map_add(string_map_t *map, const char *key, void *data) {
+    struct string_map_slot *slot = NULL;
+    uint64_t hash;
+
+    assert(map != NULL);
+    assert(key != NULL);
+
+    if (_needs_grow(map)) {
+        _resize(map, map->nslots * 2);
+    }
+
+    hash = _hash_string(key);
+    slot = _find_slot(map->slots, map->nslots, key, hash);
+
+    if (slot->key != NULL) {
+        return false;
+    }
+
+    slot->key = key;
+    slot->data = data;
+    slot->hash = hash;
+    map->count++;
+
+    return true;
+}
+
+/*
+ * Look up key.  Returns true if it is in the map and stores its data
+ * in *data if data is not NULL.
+ */
+bool string_map_get(const string_map_t *map, const char *key, void **data) {
+    struct string_map_slot *slot = NULL;
+
+    assert(map != NULL);
+    assert(key != NULL);
+
+    slot = _find_slot(map->slots, map->nslots, key, _hash_string(key));
+
+    if (slot->key == NULL) {
+        return false;
+    }
+
+    if (data != NULL) {
+        *data = slot->data;
+    }
+
+    return true;
+}
+
+void string_map_free(string_map_t *map) {
+    if (map == NULL) {
+        return;
+    }
+
+    free(map->slots);
+    free(map);
+    return;
+}
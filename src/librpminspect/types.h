@@ -40,6 +40,15 @@ typedef struct _string_entry_t {
 
 typedef TAILQ_HEAD(string_entry_s, _string_entry_t) string_list_t;
 
+/* String keyed hash table (strmap.c) */
+typedef struct string_map string_map_t;
+
+/* Multi-pattern literal scanner (scanner.c) */
+typedef struct scanner scanner_t;
+
+/* License database, JSON or compiled (licensedb.c) */
+typedef struct licensedb licensedb_t;
+
 /*
  * A file is information about a file in an RPM payload.
  *
@@ -51,33 +60,66 @@ typedef TAILQ_HEAD(string_entry_s, _string_entry_t) string_list_t;
  * "st" is the metadata about the file, as described by the RPM payload. st not
  * necessarily match the description of the file in the RPM header.
  *
- * The rpm_header field is shared by multiple files. Each file entry must
- * call headerFree to dereference the header.
+ * The rpm_header field is shared by all files of a package.  The file
+ * list holds the one reference to it.  Entries and their strings are
+ * allocated together with the list and released by free_files(), never
+ * free them one by one.
  *
  * idx is the index for this file into the RPM array tags such as RPMTAG_FILESIZES.
+ *
+ * When the payload is streamed instead of unpacked (see the stream
+ * member of struct rpminspect), contents holds the data of a regular
+ * file while the inspections look at it and is NULL otherwise.
  */
 typedef struct _rpmfile_entry_t {
     Header rpm_header;
+    char *localpath;
     char *fullpath;
     struct stat st;
     int idx;
+    void *contents;
+    size_t contents_size;
     TAILQ_ENTRY(_rpmfile_entry_t) items;
 } rpmfile_entry_t;
 
 typedef TAILQ_HEAD(rpmfile_s, _rpmfile_entry_t) rpmfile_t;
 
+/*
+ * The same files as an rpmfile_t, as parallel arrays indexed by the
+ * position of the file in the list (see get_file_table()).  path[i] is
+ * the offset of the path of file i in paths and idx[i] is its index
+ * into the RPM array tags.  The arrays are sized once from the number
+ * of files in the header and belong to the list.
+ */
+#define RPMFILE_UNPACKED 0x01  /* written to disk by extract_rpm() */
+
+typedef struct _rpmfile_table_t {
+    size_t count;
+    mode_t *mode;
+    off_t *size;
+    uint32_t *path;
+    int32_t *idx;
+    uint8_t *flags;
+    char *paths;
+    rpmfile_entry_t **entries;
+} rpmfile_table_t;
+
 /*
  * A peer is a mapping of a built RPM from the before and after builds.
  * We can expand this struct as necessary based on what tests need to
  * reference.
  */
 typedef struct _rpmpeer_entry_t {
+    char *name;               /* package name, the same in both builds */
+    char *arch;               /* package arch, the same in both builds */
     Header before_hdr;        /* RPM header of the before package */
     Header after_hdr;         /* RPM header of the after package */
     char *before_rpm;         /* full path to the before RPM */
     char *after_rpm;          /* full path to the after RPM */
     rpmfile_t *before_files;  /* list of files in the payload of the before RPM */
     rpmfile_t *after_files;   /* list of files in the payload of the after RPM */
+    char *before_root;        /* where the payload of the before RPM is unpacked */
+    char *after_root;         /* where the payload of the after RPM is unpacked */
     TAILQ_ENTRY(_rpmpeer_entry_t) items;
 } rpmpeer_entry_t;
 
@@ -123,6 +165,8 @@ struct rpminspect {
     char *cfgfile;             /* full path to configuration file */
     char *workdir;             /* full path to working directory */
     char *worksubdir;          /* within workdir, where these builds go */
+    char *cachedir;            /* downloaded package cache (NULL: in workdir) */
+    uint64_t cachesize;        /* maximum size of the cache in bytes, 0 = off */
 
     /* Runtime data used by tests */
     char *licensedb;           /* full path to the license database */
@@ -130,11 +174,15 @@ struct rpminspect {
     /* Koji information (from config file) */
     char *kojihub;             /* URL of Koji hub */
     char *kojidownload;        /* URL to access Koji build artifacts */
+    unsigned int download_jobs;    /* concurrent downloads from Koji */
+    unsigned int download_retries; /* times to retry a failed download */
 
     /* Information used by different tests */
     string_list_t *badwords;   /* Space-delimited list of words prohibited
                                 * from certain package strings.
                                 */
+    regex_t *badwords_regex;   /* badwords compiled into one expression */
+    scanner_t *badwords_scanner; /* used instead if all words are literal */
     char *vendor;              /* Required vendor string */
     char *buildhost_subdomain; /* Required subdomain for buildhosts */
 
@@ -150,6 +198,9 @@ struct rpminspect {
     char *after;               /* after build ID arg given on cmdline */
     uint64_t tests;            /* which tests to run (default: ALL) */
     bool verbose;              /* verbose inspection output? */
+    unsigned int jobs;         /* how many jobs to run at once (default: 1) */
+    bool stream;               /* inspect payloads in memory, not unpacked */
+    bool inplace;              /* read local packages without copying them */
 
     /* accumulated data of the build set */
     Header before_srpm_hdr;    /* RPM header of the before src package */
@@ -157,6 +208,7 @@ struct rpminspect {
     char *before_srpm;         /* full path to the before source RPM file */
     char *after_srpm;          /* full path to the after source RPM file */
     rpmpeer_t *peers;          /* list of binary packages */
+    struct peer_index *peer_index; /* peers by name and arch (peers.c) */
 
     /* inspection results */
     results_t *results;
@@ -179,11 +231,44 @@ struct format {
     char *desc;
 };
 
+/*
+ * Per-file hooks for an inspection that looks at payload files.  When
+ * an inspection provides these, run_inspections() walks the payload
+ * once for all such inspections and calls the driver for each extracted
+ * regular file that matches one of the FILE_KIND_* values in kinds (see
+ * inspect.h) and passes the inspection's include/exclude path filters.
+ * path_include and path_exclude are the offsetof() of the regex_t
+ * pointers in struct rpminspect.  The driver gets the file's path as
+ * listed in the RPM header.  init and free are optional and called
+ * before and after the walk.  When the payload is streamed the driver
+ * gets the file contents in memory; set needs_path if the driver can
+ * only work on a file on disk and the file will be written out first.
+ * header is the results header the inspection reports under, used for
+ * findings about the walk itself, such as a payload that cannot be read.
+ */
+struct inspect_files {
+    unsigned int kinds;
+    char *header;
+    size_t path_include;
+    size_t path_exclude;
+    bool needs_path;
+    bool (*init)(void);
+    void (*free)(void);
+    bool (*driver)(struct rpminspect *, rpmfile_entry_t *, const char *);
+};
+
 /*
  * Definition for an inspection.  Inspections are assigned a flag (see
  * inspect.h), a short name, and a function pointer to the driver.  The
  * driver function needs to take a struct rpminspect pointer as the only
  * argument.  The driver returns true on success and false on failure.
+ *
+ * With --jobs, drivers run at the same time as other drivers, each on
+ * its own copy of the struct rpminspect.  A driver may read the shared
+ * headers, file lists and configuration, but any static or global
+ * state it keeps must be guarded (see licdb_lock in inspect_license.c
+ * and mandoc_lock in inspect_manpage.c) and any library it calls must
+ * be safe to use from several threads.
  */
 struct inspect {
     /* the inspection flag from inspect.h */
@@ -206,6 +291,12 @@ struct inspect {
     /* the driver function for the inspection */
     bool (*driver)(struct rpminspect *);
 
+    /*
+     * OPTIONAL: per-file hooks, used instead of the driver when
+     * running all selected inspections with run_inspections()
+     */
+    const struct inspect_files *files;
+
     /* OPTIONAL: long description of the inspection (displayed in --help) */
     char *desc;
 };
@@ -218,6 +309,7 @@ typedef struct _koji_rpmlist_entry_t {
     char *name;
     char *version;
     char *release;
+    char *payloadhash;        /* RPMTAG_SIGMD5 of the package, in hex */
     TAILQ_ENTRY(_koji_rpmlist_entry_t) items;
 } koji_rpmlist_entry_t;
 
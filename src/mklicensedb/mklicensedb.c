@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2019  Red Hat, Inc.
+ * Author(s):  David Cantrell <dcantrell@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compile a JSON license database in to the binary form the 'license'
+ * inspection loads without parsing.  Install the result next to the
+ * JSON file, e.g. generic.json and generic.ldb.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <assert.h>
+
+#include "rpminspect.h"
+
+static void usage(const char *progname) {
+    assert(progname != NULL);
+
+    printf("Compile a JSON license database for rpminspect.\n\n");
+    printf("Usage: %s [OPTIONS] LICENSEDB.json\n", progname);
+    printf("Options:\n");
+    printf("  -o FILE, --output=FILE   Write the compiled database to FILE\n");
+    printf("                             (default: LICENSEDB.ldb)\n");
+    printf("  -?, --help               Display usage information\n");
+    printf("  -V, --version            Display program version\n");
+
+    return;
+}
+
+int main(int argc, char **argv) {
+    char *progname = basename(argv[0]);
+    char *output = NULL;
+    const char *input = NULL;
+    int c;
+    int idx = 0;
+    int ret = EXIT_SUCCESS;
+    char *short_options = "o:\?V";
+    struct option long_options[] = {
+        { "output", required_argument, 0, 'o' },
+        { "help", no_argument, 0, '?' },
+        { "version", no_argument, 0, 'V' },
+        { 0, 0, 0, 0 }
+    };
+
+    while (1) {
+        c = getopt_long(argc, argv, short_options, long_options, &idx);
+
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+            case 'o':
+                free(output);
+                output = strdup(optarg);
+                break;
+            case '?':
+                usage(progname);
+                free(output);
+                exit(EXIT_SUCCESS);
+            case 'V':
+                printf("%s version %s\n", progname, PACKAGE_VERSION);
+                free(output);
+                exit(EXIT_SUCCESS);
+            default:
+                break;
+        }
+    }
+
+    if (optind != argc - 1) {
+        fprintf(stderr, "*** Expected one license database to compile.\n");
+        fprintf(stderr, "*** See `%s --help` for more information.\n", progname);
+        fflush(stderr);
+        free(output);
+        return EXIT_FAILURE;
+    }
+
+    input = argv[optind];
+
+    if (output == NULL) {
+        if (strsuffix(input, ".json")) {
+            xasprintf(&output, "%.*s.ldb", (int) strlen(input) - 5, input);
+        } else {
+            xasprintf(&output, "%s.ldb", input);
+        }
+    }
+
+    if (compile_licensedb(input, output) != 0) {
+        ret = EXIT_FAILURE;
+    }
+
+    free(output);
+    return ret;
+}
@@ -20,6 +20,9 @@
 
 #include <assert.h>
 #include <ftw.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -39,7 +42,6 @@ static char *build_desc[] = { "before", "after" };
 
 /* Local prototypes */
 static void _set_worksubdir(struct rpminspect *, bool, struct koji_build *);
-static int _get_rpm_info(const char *);
 static int _copytree(const char *, const struct stat *, int, struct FTW *);
 static int _download_rpms(struct koji_build *);
 
@@ -71,16 +73,11 @@ static void _set_worksubdir(struct rpminspect *ri, bool is_local, struct koji_bu
 }
 
 /*
- * Collect package peer information.
+ * Record a package whose header has been read.  For binary packages,
+ * files is the payload from extract_rpm(), unpacked to root, and is
+ * taken over by the peer list.
  */
-static int _get_rpm_info(const char *pkg) {
-    int ret = 0;
-    Header h;
-
-    if ((ret = get_rpm_header(pkg, &h)) != 0) {
-        return ret;
-    }
-
+static void _add_rpm_info(const char *pkg, Header h, const char *root, rpmfile_t *files) {
     if (headerIsSource(h)) {
         if (whichbuild == BEFORE_BUILD) {
             workri->before_srpm_hdr = headerCopy(h);
@@ -89,22 +86,143 @@ static int _get_rpm_info(const char *pkg) {
             workri->after_srpm_hdr = headerCopy(h);
             workri->after_srpm = strdup(pkg);
         }
+
+        free_files(files);
     } else {
-        add_peer(&workri->peers, whichbuild, pkg, &h);
+        add_peer_files(workri, whichbuild, pkg, &h, root, files);
+    }
+
+    return;
+}
+
+/*
+ * Packages found in a local build tree.  _copytree() only records
+ * them, _unpack_local_rpms() then reads their headers and extracts
+ * their payloads in parallel once the whole tree has been walked.
+ */
+struct local_rpm {
+    char *pkg;
+    char *root;
+    Header hdr;
+    rpmfile_t *files;
+    bool unpacked;
+};
+
+static struct local_rpm *local_rpms = NULL;
+static size_t nlocal_rpms = 0;
+static size_t local_rpms_alloc = 0;
+
+/*
+ * Queue a local package.  The payload is unpacked to root, or next to
+ * the package if root is NULL.
+ */
+static void _queue_local_rpm(const char *pkg, const char *root) {
+    struct local_rpm *l = NULL;
+
+    if (nlocal_rpms == local_rpms_alloc) {
+        local_rpms_alloc = (local_rpms_alloc == 0) ? 16 : local_rpms_alloc * 2;
+        local_rpms = realloc(local_rpms, local_rpms_alloc * sizeof(*local_rpms));
+        assert(local_rpms != NULL);
+    }
+
+    l = &local_rpms[nlocal_rpms++];
+    memset(l, 0, sizeof(*l));
+    l->pkg = strdup(pkg);
+    l->root = (root != NULL) ? strdup(root) : get_payload_dir(pkg);
+    assert(l->pkg != NULL);
+    assert(l->root != NULL);
+    return;
+}
+
+/* Job for run_jobs(), one per queued package */
+static void _unpack_local_rpm(void *data, unsigned int worker, size_t item) {
+    struct local_rpm *l = &local_rpms[item];
+
+    (void) data;
+    (void) worker;
+
+    if (get_rpm_header(l->pkg, &l->hdr) != 0) {
+        l->hdr = NULL;
+        return;
     }
 
-    headerFree(h);
+    if (!headerIsSource(l->hdr)) {
+        l->files = extract_rpm(workri, l->pkg, l->hdr, l->root);
+    }
+
+    l->unpacked = true;
+    return;
+}
+
+/* Drop the queued local packages */
+static void _free_local_rpms(void) {
+    struct local_rpm *l = NULL;
+    size_t i;
+
+    for (i = 0; i < nlocal_rpms; i++) {
+        l = &local_rpms[i];
+
+        if (l->hdr != NULL) {
+            headerFree(l->hdr);
+        }
+
+        free_files(l->files);
+        free(l->pkg);
+        free(l->root);
+    }
+
+    free(local_rpms);
+    local_rpms = NULL;
+    nlocal_rpms = 0;
+    local_rpms_alloc = 0;
+    return;
+}
+
+/*
+ * Unpack every queued local package using workri->jobs threads and
+ * then add them to the peer list in the order they were found, so
+ * the peer list does not depend on which job finished first.
+ */
+static int _unpack_local_rpms(void) {
+    struct local_rpm *l = NULL;
+    size_t i;
+    int ret = 0;
+
+    run_jobs(workri->jobs, nlocal_rpms, _unpack_local_rpm, NULL);
+
+    for (i = 0; i < nlocal_rpms; i++) {
+        l = &local_rpms[i];
+
+        if (!l->unpacked) {
+            fprintf(stderr, "*** Error reading RPM: %s\n", l->pkg);
+            fflush(stderr);
+            ret = -1;
+        } else if (ret == 0) {
+            _add_rpm_info(l->pkg, l->hdr, l->root, l->files);
+            l->files = NULL;
+        }
+
+    }
+
+    _free_local_rpms();
     return ret;
 }
 
 /*
  * Used to recursively copy a build tree over to the working directory.
+ * Files are reflinked or hard linked where possible (see ingestfile()),
+ * so staging a local build on the same filesystem costs almost nothing.
+ *
+ * With workri->inplace set nothing is copied.  Only the directory
+ * structure is created in the working directory so the payloads can be
+ * unpacked there, while the packages are read where they are.
  */
 static int _copytree(const char *fpath, const struct stat *sb,
                      int tflag, struct FTW *ftwbuf) {
     static int toptrim = 0;
     char *workfpath = NULL;
     char *bufpath = NULL;
+    char *root = NULL;
     int ret = 0;
 
     /*
@@ -125,7 +243,7 @@ static int _copytree(const char *fpath, const struct stat *sb,
             ret = -1;
         }
     } else if (S_ISREG(sb->st_mode)) {
-        if (copyfile(fpath, bufpath, true, false)) {
+        if (!workri->inplace && ingestfile(fpath, bufpath)) {
             fprintf(stderr, "*** Error copying file %s: %s\n", bufpath, strerror(errno));
             ret = -1;
         }
@@ -134,9 +252,15 @@ static int _copytree(const char *fpath, const struct stat *sb,
         ret = -1;
     }
 
-    /* Gather the RPM header for packages */
-    if (tflag == FTW_F && strsuffix(bufpath, ".rpm") && _get_rpm_info(bufpath)) {
-        ret = -1;
+    /* Queue packages, they are unpacked once the tree is copied */
+    if (tflag == FTW_F && strsuffix(bufpath, ".rpm")) {
+        if (workri->inplace) {
+            root = get_payload_dir(bufpath);
+            _queue_local_rpm(fpath, root);
+            free(root);
+        } else {
+            _queue_local_rpm(bufpath, NULL);
+        }
     }
 
     fflush(stderr);
@@ -145,79 +269,438 @@ static int _copytree(const char *fpath, const struct stat *sb,
     return ret;
 }
 
+/*
+ * One package being downloaded by _download_rpms().  A download is
+ * queued until a transfer slot is free and its retry time has passed,
+ * then active until curl is done with it.
+ */
+enum download_state { DOWNLOAD_QUEUED, DOWNLOAD_ACTIVE, DOWNLOAD_DONE, DOWNLOAD_FAILED };
+
+struct download {
+    enum download_state state;
+    char *src;
+    char *dst;
+    FILE *fp;
+    CURL *handle;
+    unsigned int attempts;
+    time_t retry_at;
+
+    /* the Koji package and whether it came from the cache */
+    const koji_rpmlist_entry_t *rpm;
+    bool cached;
+
+    /* filled in by the unpack workers */
+    bool unpacked;
+    char *root;
+    Header hdr;
+    rpmfile_t *files;
+};
+
+/*
+ * Downloaded packages waiting to be unpacked.  The download loop adds
+ * each package as soon as it arrives and the unpack workers read its
+ * header and extract its payload while the other transfers continue.
+ */
+struct unpack_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    struct download **items;
+    size_t head;
+    size_t tail;
+    bool closed;
+};
+
+static void _queue_unpack(struct unpack_queue *queue, struct download *d) {
+    pthread_mutex_lock(&queue->lock);
+    queue->items[queue->tail++] = d;
+    pthread_cond_signal(&queue->ready);
+    pthread_mutex_unlock(&queue->lock);
+    return;
+}
+
+/* Unpack queued packages until the queue is closed and empty */
+static void *_unpack_worker(void *arg) {
+    struct unpack_queue *queue = arg;
+    struct download *d = NULL;
+
+    while (true) {
+        pthread_mutex_lock(&queue->lock);
+
+        while (queue->head == queue->tail && !queue->closed) {
+            pthread_cond_wait(&queue->ready, &queue->lock);
+        }
+
+        if (queue->head == queue->tail) {
+            pthread_mutex_unlock(&queue->lock);
+            break;
+        }
+
+        d = queue->items[queue->head++];
+        pthread_mutex_unlock(&queue->lock);
+
+        if (get_rpm_header(d->dst, &d->hdr) != 0) {
+            d->hdr = NULL;
+            continue;
+        }
+
+        if (!d->cached) {
+            add_cached_rpm(workri, d->rpm, d->dst, d->hdr);
+        }
+
+        if (!headerIsSource(d->hdr)) {
+            d->files = extract_rpm(workri, d->dst, d->hdr, d->root);
+        }
+
+        d->unpacked = true;
+    }
+
+    return NULL;
+}
+
+/* Is a failed transfer worth trying again? */
+static bool _is_transient(CURL *handle, CURLcode cc) {
+    long status = 0;
+
+    switch (cc) {
+        case CURLE_HTTP_RETURNED_ERROR:
+            /* the server is busy or broken, but the file may be there */
+            curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &status);
+            return (status >= 500 || status == 408 || status == 429);
+        case CURLE_COULDNT_RESOLVE_HOST:
+        case CURLE_COULDNT_CONNECT:
+        case CURLE_PARTIAL_FILE:
+        case CURLE_OPERATION_TIMEDOUT:
+        case CURLE_GOT_NOTHING:
+        case CURLE_SEND_ERROR:
+        case CURLE_RECV_ERROR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Hand a queued download to curl, returns false if it could not start */
+static bool _start_download(CURLM *multi, struct download *d) {
+    if ((d->fp = fopen(d->dst, "wb")) == NULL) {
+        fprintf(stderr, "*** Unable to open %s: %s\n", d->dst, strerror(errno));
+        fflush(stderr);
+        return false;
+    }
+
+    curl_easy_setopt(d->handle, CURLOPT_WRITEDATA, d->fp);
+
+    if (curl_multi_add_handle(multi, d->handle) != CURLM_OK) {
+        fprintf(stderr, "*** Unable to start download of %s\n", d->src);
+        fflush(stderr);
+        fclose(d->fp);
+        d->fp = NULL;
+        return false;
+    }
+
+    if (workri->verbose && d->attempts == 0) {
+        printf("Downloading %s...\n", d->src);
+    }
+
+    d->attempts++;
+    d->state = DOWNLOAD_ACTIVE;
+    return true;
+}
+
+/* Record the outcome of a finished transfer, queueing a retry if it makes sense */
+static void _finish_download(CURLM *multi, struct download *d, CURLcode cc) {
+    unsigned int delay;
+
+    curl_multi_remove_handle(multi, d->handle);
+
+    if (fclose(d->fp) != 0 && cc == CURLE_OK) {
+        cc = CURLE_WRITE_ERROR;
+    }
+
+    d->fp = NULL;
+
+    if (cc == CURLE_OK) {
+        d->state = DOWNLOAD_DONE;
+        return;
+    }
+
+    if (d->attempts <= workri->download_retries && _is_transient(d->handle, cc)) {
+        delay = DOWNLOAD_RETRY_DELAY << (d->attempts - 1);
+        fprintf(stderr, "*** Error downloading %s: %s (retrying in %u second%s)\n", d->src, curl_easy_strerror(cc), delay, (delay == 1) ? "" : "s");
+        fflush(stderr);
+        d->retry_at = time(NULL) + delay;
+        d->state = DOWNLOAD_QUEUED;
+        return;
+    }
+
+    fprintf(stderr, "*** Error downloading %s: %s\n", d->src, curl_easy_strerror(cc));
+    fflush(stderr);
+    d->state = DOWNLOAD_FAILED;
+    return;
+}
+
 /*
  * Given a remote RPM specification in a Koji build, download it
- * to our working directory.
+ * to our working directory.  Up to workri->download_jobs packages
+ * are transferred at the same time over reused connections and
+ * failed transfers are retried with a growing delay.  Packages found
+ * in the package cache are not downloaded at all.  Each package is
+ * unpacked by one of workri->jobs worker threads as soon as it has
+ * arrived, and the packages are added to the peer list in build order
+ * once everything is here.
  */
 static int _download_rpms(struct koji_build *build) {
     koji_rpmlist_entry_t *rpm = NULL;
-    char *src = NULL;
+    struct download *downloads = NULL;
+    struct download *d = NULL;
     char *dst = NULL;
     char *pkg = NULL;
-    FILE *fp = NULL;
-    CURL *c = NULL;
-    int r;
-    CURLcode cc;
+    char *cached = NULL;
+    CURLM *multi = NULL;
+    CURLMsg *msg = NULL;
+    struct unpack_queue queue;
+    pthread_t *workers = NULL;
+    unsigned int nworkers = 0;
+    unsigned int w;
+    size_t ndownloads = 0;
+    size_t nactive = 0;
+    size_t remaining = 0;
+    size_t i;
+    int running;
+    int left;
+    time_t now;
+    bool failed = false;
+    int ret = 0;
 
     assert(build != NULL);
     assert(build->rpms != NULL);
 
+    TAILQ_FOREACH(rpm, build->rpms, items) {
+        ndownloads++;
+    }
+
+    if (ndownloads == 0) {
+        return 0;
+    }
+
     /* initialize curl */
-    if (!(c = curl_easy_init())) {
+    if (!(multi = curl_multi_init())) {
         return -1;
     }
 
-    curl_easy_setopt(c, CURLOPT_WRITEFUNCTION, NULL);
-    curl_easy_setopt(c, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long) workri->download_jobs);
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long) workri->download_jobs);
+
+    downloads = calloc(ndownloads, sizeof(*downloads));
+    assert(downloads != NULL);
+    i = 0;
 
     TAILQ_FOREACH(rpm, build->rpms, items) {
+        d = &downloads[i++];
+
         /* create the destination directory */
         xasprintf(&dst, "%s/%s/%s", workri->worksubdir, build_desc[whichbuild], rpm->arch);
 
         if (mkdirp(dst, mode)) {
             fprintf(stderr, "*** Error creating directory %s: %s\n", dst, strerror(errno));
             fflush(stderr);
-            return -1;
+            free(dst);
+            ret = -1;
+            goto cleanup;
         }
 
         free(dst);
 
         /* build path strings */
         xasprintf(&pkg, "%s-%s-%s.%s.rpm", rpm->name, rpm->version, rpm->release, rpm->arch);
-        xasprintf(&src, "%s/vol/%s/packages/%s/%s/%s/%s/%s", workri->kojidownload, build->volume_name, build->name, build->version, build->release, rpm->arch, pkg);
-        xasprintf(&dst, "%s/%s/%s/%s", workri->worksubdir, build_desc[whichbuild], rpm->arch, pkg);
+        xasprintf(&d->src, "%s/vol/%s/packages/%s/%s/%s/%s/%s", workri->kojidownload, build->volume_name, build->name, build->version, build->release, rpm->arch, pkg);
+        xasprintf(&d->dst, "%s/%s/%s/%s", workri->worksubdir, build_desc[whichbuild], rpm->arch, pkg);
+        d->root = get_payload_dir(d->dst);
+        free(pkg);
+        d->rpm = rpm;
+
+        /* use the cached copy if we have one */
+        if ((cached = get_cached_rpm(workri, rpm)) != NULL) {
+            if (link(cached, d->dst) == 0 || copyfile(cached, d->dst, true, false) == 0) {
+                if (workri->verbose) {
+                    printf("Using cached %s...\n", cached);
+                }
+
+                d->cached = true;
+                d->state = DOWNLOAD_DONE;
+                free(cached);
+                continue;
+            }
+
+            free(cached);
+        }
+
+        remaining++;
+
+        if (!(d->handle = curl_easy_init())) {
+            ret = -1;
+            goto cleanup;
+        }
+
+        curl_easy_setopt(d->handle, CURLOPT_URL, d->src);
+        curl_easy_setopt(d->handle, CURLOPT_PRIVATE, d);
+        curl_easy_setopt(d->handle, CURLOPT_WRITEFUNCTION, NULL);
+        curl_easy_setopt(d->handle, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(d->handle, CURLOPT_FAILONERROR, 1L);
+        curl_easy_setopt(d->handle, CURLOPT_TCP_KEEPALIVE, 1L);
+        d->state = DOWNLOAD_QUEUED;
+    }
+
+    /* start the unpack workers */
+    memset(&queue, 0, sizeof(queue));
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.ready, NULL);
+    queue.items = calloc(ndownloads, sizeof(*queue.items));
+    assert(queue.items != NULL);
+    workers = calloc(workri->jobs > 0 ? workri->jobs : 1, sizeof(*workers));
+    assert(workers != NULL);
+
+    /* this thread runs the downloads and counts against the jobs limit */
+    for (w = 0; w + 1 < workri->jobs; w++) {
+        if (pthread_create(&workers[w], NULL, _unpack_worker, &queue) != 0) {
+            /* whatever is left over is unpacked once the downloads are done */
+            break;
+        }
 
-        /* perform the download */
-        fp = fopen(dst, "wb");
-        assert(fp != NULL);
-        curl_easy_setopt(c, CURLOPT_URL, src);
-        curl_easy_setopt(c, CURLOPT_WRITEDATA, fp);
+        nworkers++;
+    }
 
-        if (workri->verbose) {
-            printf("Downloading %s...\n", src);
+    /* cached packages can be unpacked right away */
+    for (i = 0; i < ndownloads; i++) {
+        if (downloads[i].cached) {
+            _queue_unpack(&queue, &downloads[i]);
         }
+    }
+
+    /* perform the downloads */
+
+    while (remaining > 0 && !(failed && nactive == 0)) {
+        /* fill the free transfer slots, unless something already failed for good */
+        now = time(NULL);
+
+        for (i = 0; i < ndownloads && nactive < workri->download_jobs && !failed; i++) {
+            d = &downloads[i];
 
-        cc = curl_easy_perform(c);
-        assert(cc == CURLE_OK);
-        r = fclose(fp);
-        assert(r == 0);
+            if (d->state != DOWNLOAD_QUEUED || d->retry_at > now) {
+                continue;
+            }
+
+            if (!_start_download(multi, d)) {
+                d->state = DOWNLOAD_FAILED;
+                failed = true;
+                remaining--;
+                break;
+            }
 
-        /* gather the RPM header */
-        if (_get_rpm_info(dst)) {
-            fprintf(stderr, "*** Error reading RPM: %s\n", dst);
+            nactive++;
+        }
+
+        if (nactive == 0) {
+            if (!failed) {
+                /* everything left is waiting to be retried */
+                sleep(1);
+            }
+
+            continue;
+        }
+
+        curl_multi_perform(multi, &running);
+
+        while ((msg = curl_multi_info_read(multi, &left)) != NULL) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **) &d);
+            _finish_download(multi, d, msg->data.result);
+            nactive--;
+
+            if (d->state == DOWNLOAD_DONE) {
+                remaining--;
+                _queue_unpack(&queue, d);
+            } else if (d->state == DOWNLOAD_FAILED) {
+                failed = true;
+                remaining--;
+            }
+        }
+
+        if (running > 0) {
+            curl_multi_wait(multi, NULL, 0, 1000, NULL);
+        }
+    }
+
+    /* let the workers finish, helping out with anything still queued */
+    pthread_mutex_lock(&queue.lock);
+    queue.closed = true;
+    pthread_cond_broadcast(&queue.ready);
+    pthread_mutex_unlock(&queue.lock);
+
+    _unpack_worker(&queue);
+
+    for (w = 0; w < nworkers; w++) {
+        pthread_join(workers[w], NULL);
+    }
+
+    /* make room in the package cache, now that nothing is adding to it */
+    trim_cache(workri);
+
+    free(workers);
+    free(queue.items);
+    pthread_cond_destroy(&queue.ready);
+    pthread_mutex_destroy(&queue.lock);
+
+    if (failed) {
+        ret = -1;
+        goto cleanup;
+    }
+
+    /* add the packages in build order so the peer list is always the same */
+    for (i = 0; i < ndownloads; i++) {
+        d = &downloads[i];
+
+        if (!d->unpacked) {
+            fprintf(stderr, "*** Error reading RPM: %s\n", d->dst);
             fflush(stderr);
-            return -1;
+            ret = -1;
+            goto cleanup;
         }
 
-        /* start over */
-        free(src);
-        free(dst);
-        free(pkg);
+        _add_rpm_info(d->dst, d->hdr, d->root, d->files);
+        d->files = NULL;
     }
 
-    curl_easy_cleanup(c);
+cleanup:
+    for (i = 0; i < ndownloads; i++) {
+        d = &downloads[i];
 
-    return 0;
+        if (d->hdr != NULL) {
+            headerFree(d->hdr);
+        }
+
+        free_files(d->files);
+
+        if (d->handle != NULL) {
+            if (d->state == DOWNLOAD_ACTIVE) {
+                curl_multi_remove_handle(multi, d->handle);
+                fclose(d->fp);
+            }
+
+            curl_easy_cleanup(d->handle);
+        }
+
+        free(d->src);
+        free(d->dst);
+        free(d->root);
+    }
+
+    free(downloads);
+    curl_multi_cleanup(multi);
+
+    return ret;
 }
 
 /*
@@ -243,6 +726,13 @@ int gather_builds(struct rpminspect *ri) {
             if (nftw(ri->after, _copytree, 15, FTW_PHYS) == -1) {
                 fprintf(stderr, "*** Error gathering build %s: %s\n", ri->after, strerror(errno));
                 fflush(stderr);
+                _free_local_rpms();
+                return -1;
+            }
+
+            if (_unpack_local_rpms()) {
+                fprintf(stderr, "*** Error gathering build %s\n", ri->after);
+                fflush(stderr);
                 return -1;
             }
         } else if ((build = get_koji_build(ri, ri->after)) != NULL) {
@@ -275,6 +765,13 @@ int gather_builds(struct rpminspect *ri) {
         if (nftw(ri->before, _copytree, 15, FTW_PHYS) == -1) {
             fprintf(stderr, "*** Error gathering build %s: %s\n", ri->before, strerror(errno));
             fflush(stderr);
+            _free_local_rpms();
+            return -1;
+        }
+
+        if (_unpack_local_rpms()) {
+            fprintf(stderr, "*** Error gathering build %s\n", ri->before);
+            fflush(stderr);
             return -1;
         }
     } else if ((build = get_koji_build(ri, ri->before)) != NULL) {
@@ -23,6 +23,7 @@
 #include <getopt.h>
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
@@ -51,6 +52,12 @@ static void usage(const char *progname) {
     printf("  -l, --list               List available tests and formats\n");
     printf("  -w PATH, --workdir=PATH  Temporary directory to use\n");
     printf("                             (default: %s)\n", DEFAULT_WORKDIR);
+    printf("  -j N, --jobs=N           Use up to N threads in total to unpack\n");
+    printf("                             and inspect packages (default: 1)\n");
+    printf("  -s, --stream             Inspect payloads in memory instead of\n");
+    printf("                             unpacking them to the working directory\n");
+    printf("  -i, --in-place           Read local builds where they are instead\n");
+    printf("                             of copying them to the working directory\n");
     printf("  -k, --keep               Do not remove the comparison working files\n");
     printf("  -v, --verbose            Verbose inspection output\n");
     printf("                           when finished, display full path\n");
@@ -66,7 +73,7 @@ int main(int argc, char **argv) {
     int c, i;
     int idx = 0;
     int ret = EXIT_SUCCESS;
-    char *short_options = "c:T:o:F:lw:kv\?V";
+    char *short_options = "c:T:o:F:lw:j:sikv\?V";
     struct option long_options[] = {
         { "config", required_argument, 0, 'c' },
         { "tests", required_argument, 0, 'T' },
@@ -74,6 +81,9 @@ int main(int argc, char **argv) {
         { "output", required_argument, 0, 'o' },
         { "format", required_argument, 0, 'F' },
         { "workdir", required_argument, 0, 'w' },
+        { "jobs", required_argument, 0, 'j' },
+        { "stream", no_argument, 0, 's' },
+        { "in-place", no_argument, 0, 'i' },
         { "keep", no_argument, 0, 'k' },
         { "verbose", no_argument, 0, 'v' },
         { "help", no_argument, 0, '?' },
@@ -86,6 +96,10 @@ int main(int argc, char **argv) {
     int formatidx = -1;
     bool keep = false;
     bool verbose = false;
+    bool stream = false;
+    bool inplace = false;
+    long jobs = 1;
+    char *endptr = NULL;
     int mode = S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH;
     bool found = false;
     char *test = NULL;
@@ -193,6 +207,23 @@ int main(int argc, char **argv) {
             case 'w':
                 workdir = strdup(optarg);
                 break;
+            case 'j':
+                errno = 0;
+                jobs = strtol(optarg, &endptr, 10);
+
+                if (errno != 0 || *endptr != '\0' || jobs < 1 || jobs > UINT_MAX) {
+                    fprintf(stderr, "*** Invalid number of jobs: `%s`.\n", optarg);
+                    fflush(stderr);
+                    return EXIT_FAILURE;
+                }
+
+                break;
+            case 's':
+                stream = true;
+                break;
+            case 'i':
+                inplace = true;
+                break;
             case 'k':
                 keep = true;
                 break;
@@ -221,6 +252,9 @@ int main(int argc, char **argv) {
 
     /* various options from the command line */
     ri.verbose = verbose;
+    ri.jobs = jobs;
+    ri.stream = stream;
+    ri.inplace = inplace;
 
     /* Copy in user-selected tests if they specified something */
     if (selected != 0) {
@@ -276,20 +310,8 @@ int main(int argc, char **argv) {
     }
 
     /* perform the selected inspections */
-    for (i = 0; inspections[i].flag != 0; i++) {
-        /* test not selected by user */
-        if (!(ri.tests & inspections[i].flag)) {
-            continue;
-        }
-
-        /* inspection requires before/after builds and we have one */
-        if (ri.before == NULL && !inspections[i].single_build) {
-            continue;
-        }
-
-        if (!inspections[i].driver(&ri)) {
-            ret = EXIT_FAILURE;
-        }
+    if (!run_inspections(&ri)) {
+        ret = EXIT_FAILURE;
     }
 
     /* output the results */
@@ -305,8 +327,9 @@ int main(int argc, char **argv) {
     if (keep) {
         printf("Keeping working directory: %s\n", ri.worksubdir);
     } else {
-        if (rmtree(ri.workdir, true, true)) {
-            fprintf(stderr, "*** Error removing directory %s: %s\n", ri.workdir, strerror(errno));
+        /* only this run's files, the package cache lives in workdir too */
+        if (ri.worksubdir != NULL && rmtree(ri.worksubdir, true, false)) {
+            fprintf(stderr, "*** Error removing directory %s: %s\n", ri.worksubdir, strerror(errno));
            fflush(stderr);
         }
     }
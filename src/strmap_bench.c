@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2019  Red Hat, Inc.
+ * Author(s):  David Cantrell <dcantrell@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Time string_map against the hsearch_r() table it replaced, using a
+ * set of paths shaped like a package payload.  The table is sized the
+ * way the old path table was sized, one slot per file.  glibc's hsearch
+ * hash only keeps the last eight or so characters of a key, so payload
+ * paths that differ in a short suffix collide heavily; keep NPATHS
+ * modest or the hsearch_r half runs for minutes.  Not installed, run it
+ * by hand:
+ *
+ *     ./strmap_bench [NPATHS] [ROUNDS]
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <search.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rpminspect.h"
+
+static double _now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Paths like /usr/lib/debug/.build-id/ab/cdef....debug and friends */
+static char **_make_paths(size_t npaths, const char *prefix)
+{
+    static const char *dirs[] = {
+        "/usr/lib64/python3.7/site-packages/pkg%zu/sub%zu/module_%zu.py",
+        "/usr/share/doc/package-%zu/examples/%zu/README.%zu",
+        "/usr/lib/debug/.build-id/%02zx/%08zx%08zx.debug",
+        "/usr/share/locale/l%zu/LC_MESSAGES/domain%zu-%zu.mo",
+        "/usr/include/project/detail/%zu/header_%zu_%zu.h",
+    };
+    char **paths = NULL;
+    char *tmp = NULL;
+    size_t i;
+
+    paths = calloc(npaths, sizeof(*paths));
+    assert(paths != NULL);
+
+    for (i = 0; i < npaths; i++) {
+        xasprintf(&tmp, dirs[i % 5], i % 97, i * 2654435761u % 100003, i);
+        xasprintf(&paths[i], "%s%s", prefix, tmp);
+        free(tmp);
+    }
+
+    return paths;
+}
+
+static void _report(const char *what, double insert, double hit, double miss, size_t n, unsigned int rounds)
+{
+    printf("%-10s insert %8.1f ns  hit %8.1f ns  miss %8.1f ns\n", what,
+           insert * 1e9 / (n * rounds), hit * 1e9 / (n * rounds), miss * 1e9 / (n * rounds));
+    return;
+}
+
+int main(int argc, char **argv)
+{
+    size_t npaths = (argc > 1) ? strtoul(argv[1], NULL, 10) : 20000;
+    unsigned int rounds = (argc > 2) ? strtoul(argv[2], NULL, 10) : 3;
+    char **paths = NULL;
+    char **missing = NULL;
+    string_map_t *map = NULL;
+    struct hsearch_data table;
+    ENTRY e;
+    ENTRY *eptr = NULL;
+    double insert = 0, hit = 0, miss = 0;
+    double start;
+    size_t found = 0;
+    size_t i;
+    unsigned int r;
+
+    if (npaths == 0 || rounds == 0) {
+        fprintf(stderr, "*** Usage: %s [NPATHS] [ROUNDS]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    paths = _make_paths(npaths, "");
+    missing = _make_paths(npaths, "/opt");
+    printf("%zu paths, %u rounds, time per operation\n", npaths, rounds);
+
+    for (r = 0; r < rounds; r++) {
+        start = _now();
+        map = string_map_new(npaths);
+
+        for (i = 0; i < npaths; i++) {
+            string_map_add(map, paths[i], paths[i]);
+        }
+
+        insert += _now() - start;
+        start = _now();
+
+        for (i = 0; i < npaths; i++) {
+            found += string_map_get(map, paths[i], NULL);
+        }
+
+        hit += _now() - start;
+        start = _now();
+
+        for (i = 0; i < npaths; i++) {
+            found += string_map_get(map, missing[i], NULL);
+        }
+
+        miss += _now() - start;
+        string_map_free(map);
+    }
+
+    _report("string_map", insert, hit, miss, npaths, rounds);
+    insert = hit = miss = 0;
+
+    for (r = 0; r < rounds; r++) {
+        start = _now();
+        memset(&table, 0, sizeof(table));
+        assert(hcreate_r(npaths, &table) != 0);
+
+        for (i = 0; i < npaths; i++) {
+            e.key = paths[i];
+            e.data = paths[i];
+            hsearch_r(e, ENTER, &eptr, &table);
+        }
+
+        insert += _now() - start;
+        start = _now();
+
+        for (i = 0; i < npaths; i++) {
+            e.key = paths[i];
+            found += hsearch_r(e, FIND, &eptr, &table) != 0;
+        }
+
+        hit += _now() - start;
+        start = _now();
+
+        for (i = 0; i < npaths; i++) {
+            e.key = missing[i];
+            found += hsearch_r(e, FIND, &eptr, &table) != 0;
+        }
+
+        miss += _now() - start;
+        hdestroy_r(&table);
+    }
+
+    _report("hsearch_r", insert, hit, miss, npaths, rounds);
+
+    /* both tables must have found every path and nothing else */
+    if (found != 2 * npaths * rounds) {
+        fprintf(stderr, "*** Lookups disagree: %zu found, expected %zu\n", found, 2 * npaths * rounds);
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < npaths; i++) {
+        free(paths[i]);
+        free(missing[i]);
+    }
+
+    free(paths);
+    free(missing);
+    return EXIT_SUCCESS;
+}